@@ -9,18 +9,20 @@
 #include "mmio.h"
 
 /* Constants (to be adapted if necessary) */
-static int const  time_divisor       = 1;
 static bool const single_step        = false;
 static bool const fail_on_all_faults = false;
 
 /* RAM */
 #define RAM_AMT 64 * 1024 * 1024
-static uint8_t ram_image[RAM_AMT] = {0};
+static uint8_t ram_image[RAM_AMT] __attribute__((aligned(64))) = {0};
 
-/* Kernel image and DTB that get linked in */
+/* Kernel image and DTB that get linked in; with KERNEL_FROM_BLK the kernel is
+ * read from the block device instead */
+#ifndef KERNEL_FROM_BLK
 extern uint8_t _binary_build_kernel_bin_start;
 extern uint8_t _binary_build_kernel_bin_end;
 extern uint8_t _binary_build_kernel_bin_size;
+#endif
 extern uint8_t _binary_build_dtb_bin_start;
 extern uint8_t _binary_build_dtb_bin_end;
 extern uint8_t _binary_build_dtb_bin_size;
@@ -59,6 +61,8 @@ static int     ReadKBByte();
 
 #include "mini-rv32ima.h"
 static void DumpState(struct MiniRV32IMAState *core, uint8_t *ram_image);
+static void WaitForTimer(struct MiniRV32IMAState *core);
+static bool LoadKernel(void);
 
 struct MiniRV32IMAState *core;
 
@@ -66,8 +70,8 @@ int main(void) {
     puts("\n\nStarting...\n\n");
 restart:
     // Set up kernel image
-    memcpy(ram_image, &_binary_build_kernel_bin_start,
-           (size_t)&_binary_build_kernel_bin_size);
+    if (!LoadKernel())
+        return 1;
 
     // Set up DTB
     int dtb_ptr = RAM_AMT - (size_t)&_binary_build_dtb_bin_size
@@ -90,11 +94,11 @@ restart:
 
     // Image is loaded.
     uint64_t rt;
-    uint64_t lastTime        = 0;
+    uint64_t lastTime        = timer_read();
     int      instrs_per_flip = single_step ? 1 : 1024;
     for (rt = 0;; rt += instrs_per_flip) {
         uint64_t *this_ccount = ((uint64_t *)&core->cyclel);
-        uint32_t elapsedUs = elapsedUs = *this_ccount / time_divisor - lastTime;
+        uint32_t  elapsedUs   = timer_read() - lastTime;
         lastTime += elapsedUs;
 
         if (single_step)
@@ -107,6 +111,9 @@ restart:
             case 0:
                 break;
             case 1:
+                // The emulated core waits for its timer, sleep on ours
+                // instead of spinning until it fires.
+                WaitForTimer(core);
                 *this_ccount += instrs_per_flip;
                 break;
             case 0x7777:
@@ -127,6 +134,24 @@ restart:
 // Platform-specific functionality
 //////////////////////////////////////////////////////////////////////////
 
+// Put the kernel at the start of RAM, below the DTB and the core state.
+static bool LoadKernel(void) {
+#ifdef KERNEL_FROM_BLK
+    uint32_t sectors = blk_sectors();
+    size_t   room    = RAM_AMT - (size_t)&_binary_build_dtb_bin_size
+                  - sizeof(struct MiniRV32IMAState);
+    if (sectors == 0 || sectors > room / BLK_SECTOR_SIZE
+        || blk_read(0, ram_image, sectors) != 0) {
+        printf("Failed reading the kernel from the block device\n");
+        return false;
+    }
+#else
+    memcpy(ram_image, &_binary_build_kernel_bin_start,
+           (size_t)&_binary_build_kernel_bin_size);
+#endif
+    return true;
+}
+
 static int ReadKBByte() {
     char rxchar = 0;
     int  rread  = getchar();
@@ -142,6 +167,17 @@ static int IsKBHit() {
     return uart_available();
 }
 
+static void WaitForTimer(struct MiniRV32IMAState *core) {
+    uint64_t timer = ((uint64_t)core->timerh << 32) | core->timerl;
+    uint64_t match = ((uint64_t)core->timermatchh << 32) | core->timermatchl;
+    if (!match || match <= timer)
+        return;
+    // The emulated timer advances in lockstep with ours, so its deadline is
+    // the same distance away on our mtime.
+    timer_set_cmp(timer_read() + (match - timer));
+    timer_wait();
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Rest of functions functionality
 //////////////////////////////////////////////////////////////////////////
@@ -23,6 +23,46 @@ int uart_available(void) {
     return !!(*UART_STATUS);
 }
 
+/* Read the 64 bit machine timer (in microseconds). */
+uint64_t timer_read(void) {
+    uint32_t hi, lo;
+    do {
+        hi = *MTIME_HI;
+        lo = *MTIME_LO;
+    } while (hi != *MTIME_HI);
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Set the timer compare value without spuriously raising the interrupt. */
+void timer_set_cmp(uint64_t cmp) {
+    *MTIMECMP_HI = 0xFFFFFFFF;
+    *MTIMECMP_LO = (uint32_t)cmp;
+    *MTIMECMP_HI = (uint32_t)(cmp >> 32);
+}
+
+/* Sleep until mtime reaches the compare value. */
+void timer_wait(void) {
+    __asm__ volatile("wfi");
+}
+
+/* Size of the block device in sectors, 0 if there is none. */
+uint32_t blk_sectors(void) {
+    return *BLK_SECTORS;
+}
+
+/* Copy count sectors from sector on to dst, which must be 64-byte aligned.
+ * Returns 0 on success. dst must not be accessed while the copy runs. */
+int blk_read(uint32_t sector, void *dst, uint32_t count) {
+    *BLK_SECTOR = sector;
+    *BLK_ADDR   = (uint32_t)(uintptr_t)dst;
+    *BLK_COUNT  = count;
+    *BLK_CMD    = 1;
+    uint32_t status;
+    while ((status = *BLK_CMD) & BLK_BUSY)
+        ;
+    return status & BLK_ERROR ? -1 : 0;
+}
+
 /* Shut the system down (i.e., exit the simulation) */
 __attribute__((noreturn)) void _exit(int c) {
     *SYSTEM_EXIT = c;
@@ -6,15 +6,36 @@
 #include <stdio.h>
 
 /* Function prototypes */
-int  uart_getchar(FILE *file);
-int  uart_putchar(char c, FILE *file);
-int  uart_available(void);
-void _exit(int c);
+int      uart_getchar(FILE *file);
+int      uart_putchar(char c, FILE *file);
+int      uart_available(void);
+uint64_t timer_read(void);
+void     timer_set_cmp(uint64_t cmp);
+void     timer_wait(void);
+uint32_t blk_sectors(void);
+int      blk_read(uint32_t sector, void *dst, uint32_t count);
+void     _exit(int c);
 
-/* MMIO addresses */
+/* MMIO addresses, must match the regions in softcore/proc/Controller.bsv */
 static volatile int *const UART_BASE   = (int *)0xF0000000;
 static volatile int *const UART_DATA   = UART_BASE;
 static volatile int *const UART_STATUS = (int *)((uintptr_t)UART_BASE + 5);
 static volatile int *const SYSTEM_EXIT = (int *)0xF000FFF8;
 
+/* Machine timer, mtime counts microseconds */
+static volatile uint32_t *const MTIME_LO    = (uint32_t *)0xF0001000;
+static volatile uint32_t *const MTIME_HI    = (uint32_t *)0xF0001004;
+static volatile uint32_t *const MTIMECMP_LO = (uint32_t *)0xF0001008;
+static volatile uint32_t *const MTIMECMP_HI = (uint32_t *)0xF000100C;
+
+/* Block device, copies whole sectors into RAM by DMA */
+#define BLK_SECTOR_SIZE 512
+static volatile uint32_t *const BLK_SECTOR  = (uint32_t *)0xF0002000;
+static volatile uint32_t *const BLK_ADDR    = (uint32_t *)0xF0002004;
+static volatile uint32_t *const BLK_COUNT   = (uint32_t *)0xF0002008;
+static volatile uint32_t *const BLK_CMD     = (uint32_t *)0xF000200C;
+static volatile uint32_t *const BLK_SECTORS = (uint32_t *)0xF0002010;
+#define BLK_BUSY  0x1
+#define BLK_ERROR 0x2
+
 #endif /* MMIO_H */
@@ -0,0 +1,145 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BlockDevice.hpp"
+
+BlockDevice::BlockDevice(Dram &dram)
+    : dram(dram), proxy(nullptr), proxy_mutex(nullptr), fd(-1), num_sectors(0),
+      req_sector(0), req_count(0), req_addr(0) {
+    event_fd = eventfd(0, EFD_NONBLOCK);
+    pthread_mutex_init(&mutex, nullptr);
+}
+
+bool BlockDevice::open(const char *path) {
+    fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror("ERROR: BlockDevice::open(): failed opening the image");
+        return false;
+    }
+    uint64_t n = ((uint64_t)st.st_size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    if (n > UINT32_MAX) {
+        fprintf(stderr, "ERROR: BlockDevice::open(): %s is too large\n", path);
+        return false;
+    }
+    num_sectors = n;
+    fprintf(stderr, "[Info] Block device with %u sectors from %s\n", num_sectors, path);
+    return true;
+}
+
+void BlockDevice::setProxy(BridgeRequestProxy *proxy, pthread_mutex_t *proxy_mutex) {
+    this->proxy = proxy;
+    this->proxy_mutex = proxy_mutex;
+}
+
+uint32_t BlockDevice::sectors() {
+    return num_sectors;
+}
+
+// pread() all of len bytes unless the file ends first, zero the rest
+static bool read_full(int fd, uint8_t *buf, uint64_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pread(fd, buf, len, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            perror("ERROR: BlockDevice::read(): failed reading the image");
+            return false;
+        }
+        if (n == 0) {
+            memset(buf, 0, len);
+            return true;
+        }
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool BlockDevice::readToDram(uint64_t offset, uint64_t len, uint32_t addr) {
+    return read_full(fd, dram.at(addr), len, offset);
+}
+
+bool BlockDevice::readToBram(uint64_t offset, uint64_t len, uint32_t addr) {
+    uint8_t buf[64 * Dram::LINE_SIZE];
+    for (uint64_t done = 0; done < len; done += sizeof(buf)) {
+        uint64_t chunk = len - done < sizeof(buf) ? len - done : sizeof(buf);
+        if (!read_full(fd, buf, chunk, offset + done)) {
+            return false;
+        }
+        pthread_mutex_lock(proxy_mutex);
+        for (uint64_t i = 0; i < chunk; i += Dram::LINE_SIZE) {
+            bsvvector_Luint32_t_L16 line;
+            memcpy(line, buf + i, Dram::LINE_SIZE);
+            proxy->blkData(addr + done + i, line);
+        }
+        pthread_mutex_unlock(proxy_mutex);
+    }
+    return true;
+}
+
+void BlockDevice::read(uint32_t sector, uint32_t count, uint32_t addr) {
+    pthread_mutex_lock(&mutex);
+    req_sector = sector;
+    req_count = count;
+    req_addr = addr;
+    pthread_mutex_unlock(&mutex);
+    eventfd_write(event_fd, 1);
+}
+
+int BlockDevice::eventFd() {
+    return event_fd;
+}
+
+void BlockDevice::transfer() {
+    eventfd_t v;
+    if (eventfd_read(event_fd, &v) < 0) {
+        return;
+    }
+    pthread_mutex_lock(&mutex);
+    uint32_t sector = req_sector;
+    uint32_t count = req_count;
+    uint32_t addr = req_addr;
+    pthread_mutex_unlock(&mutex);
+
+    uint64_t offset = (uint64_t)sector * SECTOR_SIZE;
+    uint64_t len = (uint64_t)count * SECTOR_SIZE;
+    bool ok = false;
+    if ((uint64_t)sector + count > num_sectors) {
+        fprintf(stderr, "[Warning] Block read of sectors %u+%u past the end of the device\n",
+                sector, count);
+    } else if (addr % Dram::LINE_SIZE != 0) {
+        fprintf(stderr, "[Warning] Block read to unaligned address 0x%08x\n", addr);
+    } else if (dram.contains(addr, len)) {
+        ok = readToDram(offset, len, addr);
+    } else if ((uint64_t)addr + len <= BRAM_SIZE
+               && ((uint64_t)addr + len <= Dram::BASE
+                   || addr >= Dram::BASE + (uint64_t)dram.size())) {
+        ok = readToBram(offset, len, addr);
+    } else {
+        fprintf(stderr, "[Warning] Block read to 0x%08x+%" PRIu64 " is not all in the BRAM "
+                "or all in the host's RAM\n", addr, len);
+    }
+    pthread_mutex_lock(proxy_mutex);
+    proxy->blkDone(!ok);
+    pthread_mutex_unlock(proxy_mutex);
+}
+
+void BlockDevice::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    if (event_fd >= 0) {
+        ::close(event_fd);
+        event_fd = -1;
+    }
+}
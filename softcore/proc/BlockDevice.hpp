@@ -0,0 +1,57 @@
+#ifndef BLOCK_DEVICE_HPP
+#define BLOCK_DEVICE_HPP
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "BridgeRequest.h"
+#include "Dram.hpp"
+
+// Read-only block device backed by a host file.
+//
+// The guest describes a transfer of whole sectors to a line-aligned guest
+// address in the controller's block device registers; the controller flushes
+// its caches and forwards it as a blkRead indication. The bridge's event
+// loop then performs the transfer, so that the indication thread keeps
+// serving the controller meanwhile. Destinations in the host-backed DRAM are
+// read straight from the file into it, others are sent to the BRAM a line at
+// a time. The file's last sector is padded with zeroes.
+class BlockDevice {
+public:
+    static const uint32_t SECTOR_SIZE = 512;
+    // bytes the BRAM's Bit#(24) line addresses in Controller.bsv cover
+    static const uint64_t BRAM_SIZE = (uint64_t)1 << 30;
+
+    BlockDevice(Dram &dram);
+    bool open(const char *path);
+    void setProxy(BridgeRequestProxy *proxy, pthread_mutex_t *proxy_mutex);
+    // 0 if no file is open
+    uint32_t sectors();
+
+    // called from the indication thread, the transfer is left to transfer()
+    void read(uint32_t sector, uint32_t count, uint32_t addr);
+    // readable when a transfer was requested, then call transfer()
+    int eventFd();
+    // perform the requested transfer and answer it with blkDone
+    void transfer();
+    void close();
+
+private:
+    bool readToDram(uint64_t offset, uint64_t len, uint32_t addr);
+    bool readToBram(uint64_t offset, uint64_t len, uint32_t addr);
+
+    Dram &dram;
+    BridgeRequestProxy *proxy;
+    pthread_mutex_t *proxy_mutex;
+    int fd;
+    uint32_t num_sectors;
+    int event_fd;
+
+    // the requested transfer, the controller has one at a time
+    pthread_mutex_t mutex;
+    uint32_t req_sector;
+    uint32_t req_count;
+    uint32_t req_addr;
+};
+
+#endif
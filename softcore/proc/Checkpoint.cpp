@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+
+#include "Checkpoint.hpp"
+
+#define CHECKPOINT_MAGIC "RVCKPT\0\0"
+#define CHECKPOINT_VERSION 2
+
+// Flash and RAM regions of guest/link.ld
+#define FLASH_BASE 0x00000000
+#define FLASH_SIZE (8 << 20)
+#define RAM_BASE 0x20000000
+#define RAM_SIZE (80 << 20)
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t pc;
+    uint32_t regs[32];
+    uint64_t mtime;
+    uint64_t mtimecmp;
+    uint64_t cycles;
+    uint32_t timer_divisor;
+    uint32_t reserved;
+    uint64_t chunks;
+};
+
+static uint64_t monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+Checkpoint::Checkpoint(Dram &dram)
+    : dram(dram), proxy(nullptr), proxy_mutex(nullptr), halt_pending(false),
+      halt_deadline_us(0), timer_divisor(0), pc(0), mtime(0), mtimecmp(0), cycles(0),
+      busy(0), regs_received(0), dumps_done(0) {
+    event_fd = eventfd(0, EFD_NONBLOCK);
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&cond, nullptr);
+    memset(regs, 0, sizeof(regs));
+}
+
+// Memory saved in checkpoints
+std::vector<Checkpoint::Range> Checkpoint::memoryRanges() {
+    std::vector<Range> ranges = {{FLASH_BASE, FLASH_SIZE}};
+    if (dram.size() != 0) {
+        ranges.push_back({Dram::BASE, (uint32_t)dram.size()});
+    } else {
+        ranges.push_back({RAM_BASE, RAM_SIZE});
+    }
+    return ranges;
+}
+
+// The host's RAM is read directly, leaving out zero bursts like memDump
+void Checkpoint::dumpDram(const Range &range) {
+    static const uint32_t zero[BURST_LEN] = {0};
+    for (uint64_t addr = range.base; addr < (uint64_t)range.base + range.size; addr += sizeof(zero)) {
+        const uint8_t *p = dram.at(addr);
+        if (memcmp(p, zero, sizeof(zero)) != 0) {
+            memData(addr, (const uint32_t *)p);
+        }
+    }
+}
+
+void Checkpoint::setProxy(BridgeRequestProxy *proxy, pthread_mutex_t *proxy_mutex) {
+    this->proxy = proxy;
+    this->proxy_mutex = proxy_mutex;
+}
+
+void Checkpoint::setTimerDivisor(uint32_t cycles_per_us) {
+    timer_divisor = cycles_per_us;
+}
+
+int Checkpoint::eventFd() {
+    return event_fd;
+}
+
+int Checkpoint::timeoutMs() {
+    if (!halt_pending) {
+        return -1;
+    }
+    uint64_t now = monotonic_us();
+    return now >= halt_deadline_us ? 0 : (halt_deadline_us - now + 999) / 1000;
+}
+
+void Checkpoint::checkTimeout() {
+    if (!halt_pending || monotonic_us() < halt_deadline_us) {
+        return;
+    }
+    // if the core drains after all, save() just resumes it
+    fprintf(stderr, "ERROR: Checkpoint: the core did not drain within %d s, e.g. it is "
+            "waiting in a UART read; no checkpoint taken\n", HALT_TIMEOUT_S);
+    halt_pending = false;
+    pthread_mutex_lock(proxy_mutex);
+    proxy->cancelHalt();
+    pthread_mutex_unlock(proxy_mutex);
+}
+
+void Checkpoint::requestHalt() {
+    if (halt_pending) {
+        return;
+    }
+    halt_pending = true;
+    halt_deadline_us = monotonic_us() + (uint64_t)HALT_TIMEOUT_S * 1000000;
+    fprintf(stderr, "[Info] Checkpoint: halting the core\n");
+    pthread_mutex_lock(proxy_mutex);
+    proxy->haltCore();
+    pthread_mutex_unlock(proxy_mutex);
+}
+
+void Checkpoint::halted(uint32_t pc, uint64_t mtime, uint64_t mtimecmp, uint64_t cycles, uint8_t busy) {
+    pthread_mutex_lock(&mutex);
+    this->pc = pc;
+    this->mtime = mtime;
+    this->mtimecmp = mtimecmp;
+    this->cycles = cycles;
+    this->busy = busy;
+    pthread_mutex_unlock(&mutex);
+    eventfd_write(event_fd, 1);
+}
+
+void Checkpoint::regValue(uint8_t idx, uint32_t data) {
+    pthread_mutex_lock(&mutex);
+    regs[idx % 32] = data;
+    regs_received++;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+void Checkpoint::memData(uint32_t addr, const uint32_t *data) {
+    Chunk chunk;
+    chunk.addr = addr;
+    memcpy(chunk.data, data, sizeof(chunk.data));
+    pthread_mutex_lock(&mutex);
+    chunks.push_back(chunk);
+    pthread_mutex_unlock(&mutex);
+}
+
+void Checkpoint::memDumpDone() {
+    pthread_mutex_lock(&mutex);
+    dumps_done++;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+bool Checkpoint::save(const char *path) {
+    eventfd_t v;
+    eventfd_read(event_fd, &v);
+
+    pthread_mutex_lock(&mutex);
+    uint8_t halted_busy = busy;
+    pthread_mutex_unlock(&mutex);
+    const char *refused = nullptr;
+    if (!halt_pending) {
+        refused = "the halt timed out";
+    } else if (halted_busy & BUSY_UART_RX) {
+        refused = "the guest has not read all UART input yet";
+    } else if (halted_busy & BUSY_BLK) {
+        refused = "a block device transfer is in progress";
+    }
+    if (refused) {
+        pthread_mutex_lock(proxy_mutex);
+        proxy->startCore();
+        pthread_mutex_unlock(proxy_mutex);
+        if (halt_pending) {
+            fprintf(stderr, "ERROR: Checkpoint: no checkpoint taken, %s; try again later\n", refused);
+        }
+        halt_pending = false;
+        return false;
+    }
+
+    pthread_mutex_lock(&mutex);
+    regs_received = 0;
+    dumps_done = 0;
+    chunks.clear();
+    pthread_mutex_unlock(&mutex);
+
+    // requests are executed in order, so the state is read before the core
+    // is resumed
+    std::vector<Range> ranges = memoryRanges();
+    size_t dumps = 0;
+    pthread_mutex_lock(proxy_mutex);
+    for (int i = 1; i < 32; i++) {
+        proxy->readReg(i);
+    }
+    for (const Range &range : ranges) {
+        if (!dram.contains(range.base, range.size)) {
+            proxy->memDump(range.base, range.size / 4);
+            dumps++;
+        }
+    }
+    pthread_mutex_unlock(proxy_mutex);
+    for (const Range &range : ranges) {
+        if (dram.contains(range.base, range.size)) {
+            dumpDram(range);
+        }
+    }
+
+    pthread_mutex_lock(&mutex);
+    while (regs_received < 31 || dumps_done < dumps) {
+        pthread_cond_wait(&cond, &mutex);
+    }
+    CheckpointHeader header;
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.pc = pc;
+    memcpy(header.regs, regs, sizeof(header.regs));
+    header.regs[0] = 0;
+    header.mtime = mtime;
+    header.mtimecmp = mtimecmp;
+    header.cycles = cycles;
+    header.timer_divisor = timer_divisor;
+    header.reserved = 0;
+    header.chunks = chunks.size();
+    pthread_mutex_unlock(&mutex);
+
+    pthread_mutex_lock(proxy_mutex);
+    proxy->startCore();
+    pthread_mutex_unlock(proxy_mutex);
+    halt_pending = false;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror("ERROR: Checkpoint::save(): failed opening checkpoint");
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+        && (chunks.empty() || fwrite(chunks.data(), sizeof(Chunk), chunks.size(), f) == chunks.size());
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "ERROR: Checkpoint::save(): failed writing %s\n", path);
+        return false;
+    }
+    fprintf(stderr, "[Info] Checkpoint of pc 0x%08x with %zu memory bursts written to %s\n",
+            header.pc, chunks.size(), path);
+    return true;
+}
+
+bool Checkpoint::restore(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror("ERROR: Checkpoint::restore(): failed opening checkpoint");
+        return false;
+    }
+    CheckpointHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1
+            || memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0
+            || header.version != CHECKPOINT_VERSION) {
+        fprintf(stderr, "ERROR: Checkpoint::restore(): %s is not a checkpoint\n", path);
+        fclose(f);
+        return false;
+    }
+    if (header.timer_divisor != timer_divisor) {
+        fprintf(stderr, "ERROR: Checkpoint::restore(): %s was taken with the timer %s, "
+                "restore it with the same --uart-record/--uart-replay mode\n", path,
+                header.timer_divisor ? "following the cycle count" : "following host ticks");
+        fclose(f);
+        return false;
+    }
+    std::vector<Chunk> restored(header.chunks);
+    if (header.chunks != 0 && fread(restored.data(), sizeof(Chunk), header.chunks, f) != header.chunks) {
+        fprintf(stderr, "ERROR: Checkpoint::restore(): %s is truncated\n", path);
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+
+    // bursts left out of the checkpoint are zero
+    pthread_mutex_lock(proxy_mutex);
+    for (const Range &range : memoryRanges()) {
+        if (dram.contains(range.base, range.size)) {
+            memset(dram.at(range.base), 0, range.size);
+        } else {
+            proxy->memZero(range.base, range.size / 4);
+        }
+    }
+    for (Chunk &chunk : restored) {
+        if (dram.contains(chunk.addr, sizeof(chunk.data))) {
+            memcpy(dram.at(chunk.addr), chunk.data, sizeof(chunk.data));
+        } else {
+            proxy->memWrite(chunk.addr, BURST_LEN, chunk.data);
+        }
+    }
+    for (int i = 1; i < 32; i++) {
+        proxy->writeReg(i, header.regs[i]);
+    }
+    proxy->setPC(header.pc);
+    proxy->setTimer(header.mtime, header.mtimecmp, header.cycles);
+    pthread_mutex_unlock(proxy_mutex);
+
+    fprintf(stderr, "[Info] Restored pc 0x%08x with %zu memory bursts from %s\n",
+            header.pc, restored.size(), path);
+    return true;
+}
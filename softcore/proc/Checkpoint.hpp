@@ -0,0 +1,92 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "BridgeRequest.h"
+#include "Dram.hpp"
+
+// Checkpoints of the softcore's architectural state.
+//
+// A checkpoint holds the pc, the register file, the machine timer, the cycle
+// count and the timer's mode, and all non-zero memory bursts of the guest's
+// flash and RAM regions, the latter being all of the host's RAM if it serves
+// the guest's. Saving halts the core, which first drains its pipeline and
+// writes back its caches, so that no memory or MMIO request is in flight;
+// restoring happens before the core is first started.
+//
+// The rest of the controller's state is not saved. A checkpoint is refused
+// while it is not idle, i.e. while the RX FIFO holds input the guest has not
+// read or a block device transfer is in progress, and a halt is given up if
+// the core does not drain in time, e.g. because it waits in a UART read.
+class Checkpoint {
+public:
+    // must match MemBurstLen in Controller.bsv
+    static const int BURST_LEN = 16;
+    // seconds to wait for the core to drain
+    static const int HALT_TIMEOUT_S = 5;
+    // must match haltBusy* in Controller.bsv
+    static const uint8_t BUSY_UART_RX = 1;
+    static const uint8_t BUSY_BLK = 2;
+
+    Checkpoint(Dram &dram);
+    void setProxy(BridgeRequestProxy *proxy, pthread_mutex_t *proxy_mutex);
+    // the cyclesPerUs passed to timerConfig, restored checkpoints must match
+    void setTimerDivisor(uint32_t cycles_per_us);
+
+    // ask the core to halt, eventFd() becomes readable once it has
+    void requestHalt();
+    int eventFd();
+    // milliseconds until a pending halt times out, -1 if none is pending
+    int timeoutMs();
+    // give up a halt that has timed out
+    void checkTimeout();
+    // read the halted core's state, write it to path and resume the core
+    bool save(const char *path);
+    // load the state from path into the held core, the caller starts it
+    bool restore(const char *path);
+
+    // called from the indication thread
+    void halted(uint32_t pc, uint64_t mtime, uint64_t mtimecmp, uint64_t cycles, uint8_t busy);
+    void regValue(uint8_t idx, uint32_t data);
+    void memData(uint32_t addr, const uint32_t *data);
+    void memDumpDone();
+
+private:
+    struct Chunk {
+        uint32_t addr;
+        uint32_t data[BURST_LEN];
+    };
+    struct Range {
+        uint32_t base;
+        uint32_t size;
+    };
+
+    std::vector<Range> memoryRanges();
+    void dumpDram(const Range &range);
+
+    Dram &dram;
+    BridgeRequestProxy *proxy;
+    pthread_mutex_t *proxy_mutex;
+    int event_fd;
+    bool halt_pending;
+    uint64_t halt_deadline_us;
+    uint32_t timer_divisor;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t pc;
+    uint64_t mtime;
+    uint64_t mtimecmp;
+    uint64_t cycles;
+    uint8_t busy;
+    uint32_t regs[32];
+    uint32_t regs_received;
+    uint32_t dumps_done;
+    std::vector<Chunk> chunks;
+};
+
+#endif
@@ -0,0 +1,479 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "Console.hpp"
+
+Console::Console(RingBuffer &rx)
+    : rx(rx), mode(STDIO), epfd(-1), input_fd(-1), listen_fd(-1),
+      log_listen_fd(-1), pty_slave_fd(-1), input_paused(false), log_end(0),
+      stdout_lossless(false), stdout_pos(0), sending(false), send_pos(0), dirty(false) {
+    flush_fd = eventfd(0, EFD_NONBLOCK);
+    pthread_mutex_init(&log_mutex, nullptr);
+    pthread_cond_init(&log_sent, nullptr);
+}
+
+struct InputCopy {
+    int in;
+    int out;
+};
+
+static void *copy_input(void *arg) {
+    InputCopy *copy = (InputCopy *)arg;
+    char buf[4096];
+    ssize_t r;
+    while ((r = read(copy->in, buf, sizeof(buf))) > 0) {
+        for (ssize_t off = 0; off < r; ) {
+            ssize_t w = ::write(copy->out, buf + off, r - off);
+            if (w < 0) {
+                r = -1;
+                break;
+            }
+            off += w;
+        }
+    }
+    ::close(copy->in);
+    ::close(copy->out);
+    delete copy;
+    return nullptr;
+}
+
+// epoll cannot wait on regular files, so their contents are copied into a
+// pipe by a thread of their own; the pipe reaches EOF after the file does
+static int pollable(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return fd;
+    }
+    int fds[2];
+    if (pipe(fds) < 0) {
+        perror("ERROR: Console: failed creating input pipe");
+        return -1;
+    }
+    pthread_t thread;
+    pthread_create(&thread, nullptr, copy_input, new InputCopy{fd, fds[1]});
+    pthread_detach(thread);
+    return fds[0];
+}
+
+bool Console::open(const char *spec) {
+    if (strcmp(spec, "stdio") == 0) {
+        mode = STDIO;
+        input_fd = pollable(STDIN_FILENO);
+        // stdout stays blocking and is not polled
+        clients.push_back(Client{STDOUT_FILENO, 0, "", false, false, false});
+        stdout_lossless = true;
+        return true;
+    }
+
+    if (strcmp(spec, "pty") == 0) {
+        int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+            perror("ERROR: Console::open(): failed creating pty");
+            return false;
+        }
+        const char *name = ptsname(master);
+        // keep the slave open ourselves so that the master does not hang up
+        // while no terminal is attached
+        pty_slave_fd = ::open(name, O_RDWR | O_NOCTTY);
+        if (pty_slave_fd < 0) {
+            perror("ERROR: Console::open(): failed opening pty slave");
+            return false;
+        }
+        struct termios t;
+        tcgetattr(pty_slave_fd, &t);
+        cfmakeraw(&t);
+        tcsetattr(pty_slave_fd, TCSANOW, &t);
+        fprintf(stderr, "[Info] UART console on %s\n", name);
+        mode = PTY;
+        input_fd = master;
+        clients.push_back(Client{master, 0, "", false, true, false});
+        return true;
+    }
+
+    if (strncmp(spec, "unix:", 5) == 0) {
+        listen_fd = listenUnix(spec + 5);
+        if (listen_fd < 0) {
+            return false;
+        }
+        socket_path = spec + 5;
+        fprintf(stderr, "[Info] UART console on unix socket %s\n", spec + 5);
+        mode = SOCKET;
+        return true;
+    }
+
+    fprintf(stderr, "ERROR: Console::open(): unknown console \"%s\"\n", spec);
+    return false;
+}
+
+bool Console::openLogSocket(const char *path) {
+    log_listen_fd = listenUnix(path);
+    if (log_listen_fd < 0) {
+        return false;
+    }
+    log_socket_path = path;
+    fprintf(stderr, "[Info] UART log on unix socket %s\n", path);
+    return true;
+}
+
+bool Console::openInput(const char *path) {
+    if (mode != STDIO) {
+        fprintf(stderr, "ERROR: Console::openInput(): only the stdio console reads a file\n");
+        return false;
+    }
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("ERROR: Console::openInput(): failed opening input");
+        return false;
+    }
+    input_fd = pollable(fd);
+    return input_fd >= 0;
+}
+
+void Console::close() {
+    // last attempt to get the remaining output out; later output is only
+    // kept for the replay buffer
+    sendAll();
+    pthread_mutex_lock(&log_mutex);
+    stdout_lossless = false;
+    pthread_cond_broadcast(&log_sent);
+    pthread_mutex_unlock(&log_mutex);
+    for (Client &c : clients) {
+        if (c.fd != STDOUT_FILENO) {
+            ::close(c.fd);
+        }
+    }
+    clients.clear();
+    if (pty_slave_fd >= 0) {
+        ::close(pty_slave_fd);
+    }
+    if (listen_fd >= 0) {
+        ::close(listen_fd);
+        unlink(socket_path.c_str());
+    }
+    if (log_listen_fd >= 0) {
+        ::close(log_listen_fd);
+        unlink(log_socket_path.c_str());
+    }
+}
+
+int Console::listenUnix(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "ERROR: Console::listenUnix(): path too long\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || listen(fd, 8) < 0) {
+        perror("ERROR: Console::listenUnix()");
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+void Console::attach(int epfd) {
+    this->epfd = epfd;
+    int fds[] = {flush_fd, listen_fd, log_listen_fd, input_fd};
+    for (int fd : fds) {
+        if (fd < 0) {
+            continue;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+bool Console::handle(int fd, uint32_t events) {
+    if (fd == flush_fd) {
+        eventfd_t v;
+        eventfd_read(flush_fd, &v);
+        sendAll();
+    } else if (fd == listen_fd) {
+        accept(listen_fd, true);
+    } else if (fd == log_listen_fd) {
+        accept(log_listen_fd, false);
+    } else {
+        Client *c = findClient(fd);
+        if (c && (events & EPOLLOUT)) {
+            c->blocked = false;
+            send(*c);
+            updateEvents(fd);
+        }
+        if (fd == input_fd && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+            readInput();
+            if (input_fd < 0 && mode == STDIO) {
+                return false;
+            }
+        } else if (c && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+            // log tailers are read-only, anything they send is dropped
+            char buf[256];
+            ssize_t r = read(fd, buf, sizeof(buf));
+            if (r == 0 || (r < 0 && errno != EAGAIN)) {
+                c->dead = true;
+            }
+        }
+        dropDead();
+    }
+    return true;
+}
+
+void Console::accept(int lfd, bool interactive) {
+    int fd = accept4(lfd, nullptr, nullptr, SOCK_NONBLOCK);
+    if (fd < 0) {
+        return;
+    }
+    if (interactive && input_fd >= 0) {
+        const char msg[] = "console busy, connect to the log socket instead\n";
+        (void)!::write(fd, msg, sizeof(msg) - 1);
+        ::close(fd);
+        return;
+    }
+    if (interactive) {
+        input_fd = fd;
+        input_paused = false;
+    }
+
+    // replay as much of the recent output as the buffer still holds
+    pthread_mutex_lock(&log_mutex);
+    uint64_t pos = log_end > LOG_SIZE ? log_end - LOG_SIZE : 0;
+    pthread_mutex_unlock(&log_mutex);
+    clients.push_back(Client{fd, pos, "", false, true, false});
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    send(clients.back());
+    updateEvents(fd);
+}
+
+void Console::readInput() {
+    char buf[256];
+    size_t len = rx.room();
+    if (len > sizeof(buf)) {
+        len = sizeof(buf);
+    }
+    if (len == 0) {
+        // ring is full, stop reading until the guest catches up
+        input_paused = true;
+        updateEvents(input_fd);
+        return;
+    }
+    ssize_t r = read(input_fd, buf, len);
+    if (r > 0) {
+        rx.enq(buf, r);
+        return;
+    }
+    if (r < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    if (mode == PTY) {
+        // terminal detached, we still hold the slave so this is transient
+        return;
+    }
+    // EOF on stdin, or the interactive client went away
+    Client *c = findClient(input_fd);
+    if (c && mode == SOCKET) {
+        c->dead = true;
+    } else if (mode == STDIO) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, input_fd, nullptr);
+        if (input_fd != STDIN_FILENO) {
+            ::close(input_fd);
+        }
+    }
+    input_fd = -1;
+}
+
+void Console::resumeInput() {
+    if (input_paused && input_fd >= 0 && rx.room() > 0) {
+        input_paused = false;
+        updateEvents(input_fd);
+    }
+}
+
+// bytes write() can append without overwriting output that stdout still has
+// to be sent, or that send() is writing; log_mutex must be held
+size_t Console::logRoom() {
+    uint64_t oldest = log_end;
+    if (stdout_lossless && stdout_pos < oldest) {
+        oldest = stdout_pos;
+    }
+    if (sending && send_pos < oldest) {
+        oldest = send_pos;
+    }
+    return LOG_SIZE - (log_end - oldest);
+}
+
+void Console::write(const uint8_t *data, size_t len) {
+    pthread_mutex_lock(&log_mutex);
+    for (size_t done = 0; done < len; ) {
+        size_t room;
+        while ((room = logRoom()) == 0) {
+            // a whole buffer is waiting to be sent, have it sent first
+            eventfd_write(flush_fd, 1);
+            pthread_cond_wait(&log_sent, &log_mutex);
+        }
+        size_t chunk = len - done < room ? len - done : room;
+        size_t off = log_end & (LOG_SIZE - 1);
+        size_t first = chunk < LOG_SIZE - off ? chunk : LOG_SIZE - off;
+        memcpy(log + off, data + done, first);
+        memcpy(log, data + done + first, chunk - first);
+        log_end += chunk;
+        done += chunk;
+    }
+    pthread_mutex_unlock(&log_mutex);
+
+    if (memchr(data, '\n', len)) {
+        dirty = false;
+        eventfd_write(flush_fd, 1);
+    } else {
+        dirty = true;
+    }
+}
+
+void Console::flush() {
+    if (dirty.exchange(false)) {
+        eventfd_write(flush_fd, 1);
+    }
+}
+
+void Console::sendAll() {
+    for (Client &c : clients) {
+        if (!c.blocked) {
+            send(c);
+            updateEvents(c.fd);
+        }
+    }
+    dropDead();
+}
+
+void Console::send(Client &c) {
+    // the lock must not be held while writing to a client that may block;
+    // sending keeps write() from overwriting what is written straight out of
+    // log meanwhile
+    pthread_mutex_lock(&log_mutex);
+    if (log_end - c.pos > LOG_SIZE) {
+        // the client fell behind further than we can replay (never stdout,
+        // write() waits for it instead)
+        uint64_t skipped = log_end - LOG_SIZE - c.pos;
+        c.pos = log_end - LOG_SIZE;
+        c.notice += "\r\n[" + std::to_string(skipped) + " bytes dropped]\r\n";
+    }
+    size_t len = log_end - c.pos;
+    sending = true;
+    send_pos = c.pos;
+    pthread_mutex_unlock(&log_mutex);
+
+    size_t sent = 0;
+    while (!c.notice.empty() || sent < len) {
+        size_t off = (c.pos + sent) & (LOG_SIZE - 1);
+        size_t first = len - sent < LOG_SIZE - off ? len - sent : LOG_SIZE - off;
+        struct iovec iov[3];
+        iov[0].iov_base = (void *)c.notice.data();
+        iov[0].iov_len = c.notice.size();
+        iov[1].iov_base = log + off;
+        iov[1].iov_len = first;
+        iov[2].iov_base = log;
+        iov[2].iov_len = len - sent - first;
+        ssize_t n = writev(c.fd, iov, 3);
+        if (n < 0) {
+            if (errno == EAGAIN) {
+                c.blocked = true;
+            } else if (errno != EINTR) {
+                c.dead = true;
+            }
+            if (errno != EINTR) {
+                break;
+            }
+            continue;
+        }
+        size_t from_notice = (size_t)n < c.notice.size() ? n : c.notice.size();
+        c.notice.erase(0, from_notice);
+        sent += n - from_notice;
+    }
+    c.pos += sent;
+
+    pthread_mutex_lock(&log_mutex);
+    sending = false;
+    if (c.fd == STDOUT_FILENO && mode == STDIO) {
+        stdout_pos = c.pos;
+        if (c.dead) {
+            // nobody to wait for any more
+            stdout_lossless = false;
+        }
+    }
+    pthread_cond_broadcast(&log_sent);
+    pthread_mutex_unlock(&log_mutex);
+}
+
+void Console::updateEvents(int fd) {
+    if (fd < 0) {
+        return;
+    }
+    Client *c = findClient(fd);
+    bool is_input = fd == input_fd;
+    if (!is_input && (!c || !c->polled)) {
+        // stdout is written to synchronously and never polled
+        return;
+    }
+    struct epoll_event ev;
+    ev.events = 0;
+    if (!(is_input && input_paused)) {
+        ev.events = EPOLLIN;
+    }
+    if (c && c->polled && c->blocked) {
+        ev.events |= EPOLLOUT;
+    }
+    ev.data.fd = fd;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+Console::Client *Console::findClient(int fd) {
+    for (Client &c : clients) {
+        if (c.fd == fd) {
+            return &c;
+        }
+    }
+    return nullptr;
+}
+
+void Console::dropDead() {
+    for (size_t i = 0; i < clients.size();) {
+        if (!clients[i].dead) {
+            i++;
+            continue;
+        }
+        int fd = clients[i].fd;
+        if (clients[i].polled) {
+            epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        }
+        if (fd == input_fd) {
+            input_fd = -1;
+        }
+        if (fd != STDOUT_FILENO) {
+            ::close(fd);
+        }
+        clients.erase(clients.begin() + i);
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef CONSOLE_HPP
+#define CONSOLE_HPP
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "RingBuffer.hpp"
+
+// UART console of the softcore.
+//
+// The console is either the bridge's stdin/stdout, a pseudo-terminal or a
+// Unix domain socket that accepts one interactive client at a time. Any
+// number of read-only log tailers can additionally connect to a log socket.
+//
+// Guest output is appended once to a bounded replay buffer and every client
+// is served straight out of that buffer, so newly attached clients first see
+// the most recent output. A client that falls further behind than the buffer
+// holds skips ahead and is told how many bytes it missed, except for the
+// stdio console, whose output is parsed by scripts: write() waits for stdout
+// instead. write() also waits rather than overwrite the bytes that are being
+// written to a client, which is done without holding the lock. All file descriptors are driven by the bridge's epoll loop; only
+// write() and flush() may be called from other threads.
+class Console {
+public:
+    Console(RingBuffer &rx);
+
+    // spec is one of "stdio", "pty" or "unix:PATH"
+    bool open(const char *spec);
+    bool openLogSocket(const char *path);
+    // read the stdio console's input from path instead of stdin
+    bool openInput(const char *path);
+    void close();
+
+    // register the console's file descriptors with the event loop
+    void attach(int epfd);
+    // handle an epoll event on fd, returns false if the input reached EOF
+    bool handle(int fd, uint32_t events);
+    // continue reading input once the RX ring has room again
+    void resumeInput();
+
+    // guest output, flushed to the clients on newlines or by flush()
+    void write(const uint8_t *data, size_t len);
+    void flush();
+
+    static const size_t LOG_SIZE = 64 * 1024; // must be a power of two
+
+private:
+    enum Mode { STDIO, PTY, SOCKET };
+
+    struct Client {
+        int fd;
+        uint64_t pos;   // offset in the output stream of the next byte to send
+        std::string notice; // sent before the output, e.g. that some was dropped
+        bool blocked;   // waiting for EPOLLOUT
+        bool polled;    // registered with epoll
+        bool dead;
+    };
+
+    int listenUnix(const char *path);
+    void accept(int lfd, bool interactive);
+    void readInput();
+    void sendAll();
+    void send(Client &c);
+    size_t logRoom();
+    void updateEvents(int fd);
+    Client *findClient(int fd);
+    void dropDead();
+
+    RingBuffer &rx;
+    Mode mode;
+    int epfd;
+    int input_fd;
+    int listen_fd;
+    int log_listen_fd;
+    int pty_slave_fd;
+    int flush_fd;
+    bool input_paused;
+    std::string socket_path;
+    std::string log_socket_path;
+    std::vector<Client> clients;
+
+    pthread_mutex_t log_mutex;
+    uint64_t log_end; // total number of bytes ever written
+    // while stdout is a client, write() waits for it to be sent up to here
+    bool stdout_lossless;
+    uint64_t stdout_pos;
+    // while send() writes to a client, the offset it started at
+    bool sending;
+    uint64_t send_pos;
+    pthread_cond_t log_sent;
+    std::atomic<bool> dirty;
+    char log[LOG_SIZE];
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "Dram.hpp"
+
+Dram::Dram() : proxy(nullptr), proxy_mutex(nullptr), mem(nullptr), mem_size(0) {}
+
+bool Dram::open(size_t size) {
+    if (size == 0 || size % LINE_SIZE != 0 || size > 0xf0000000 - BASE) {
+        fprintf(stderr, "ERROR: Dram::open(): %zu bytes do not fit between 0x%08x and MMIO\n",
+                size, BASE);
+        return false;
+    }
+    // explicit huge pages first, they are rarely reserved, so fall back to
+    // transparent ones; pages are only populated once the guest touches them
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED) {
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            perror("ERROR: Dram::open(): failed mapping guest RAM");
+            return false;
+        }
+        madvise(p, size, MADV_HUGEPAGE);
+    }
+    mem = (uint8_t *)p;
+    mem_size = size;
+    fprintf(stderr, "[Info] %zu MB of guest RAM at 0x%08x served by the host\n",
+            size >> 20, BASE);
+    return true;
+}
+
+void Dram::setProxy(BridgeRequestProxy *proxy, pthread_mutex_t *proxy_mutex) {
+    this->proxy = proxy;
+    this->proxy_mutex = proxy_mutex;
+}
+
+size_t Dram::size() {
+    return mem_size;
+}
+
+bool Dram::contains(uint64_t addr, uint64_t len) {
+    return mem && addr >= BASE && addr + len <= BASE + (uint64_t)mem_size;
+}
+
+uint8_t *Dram::at(uint32_t addr) {
+    return mem + (addr - BASE);
+}
+
+void Dram::read(uint8_t tag, uint32_t addr) {
+    bsvvector_Luint32_t_L16 data;
+    memcpy(data, at(addr), LINE_SIZE);
+    pthread_mutex_lock(proxy_mutex);
+    proxy->dramReadResp(tag, data);
+    pthread_mutex_unlock(proxy_mutex);
+}
+
+void Dram::write(uint32_t addr, const uint32_t *data) {
+    memcpy(at(addr), data, LINE_SIZE);
+}
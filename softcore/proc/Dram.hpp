@@ -0,0 +1,45 @@
+#ifndef DRAM_HPP
+#define DRAM_HPP
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "BridgeRequest.h"
+
+// Guest RAM kept in the bridge's memory instead of the softcore's BRAM.
+//
+// Once enabled, the controller forwards the caches' line reads and write
+// backs for the range from BASE on as dramRead/dramWrite indications, which
+// are served straight from an anonymous mapping, backed by huge pages where
+// the host provides them. The host loads and checkpoints this range directly.
+class Dram {
+public:
+    // must match dramBase in Controller.bsv
+    static const uint32_t BASE = 0x20000000;
+    // must match MemBurstLen in Controller.bsv
+    static const int LINE_WORDS = 16;
+    static const size_t LINE_SIZE = LINE_WORDS * 4;
+
+    Dram();
+    // map size bytes of zeroed guest RAM
+    bool open(size_t size);
+    void setProxy(BridgeRequestProxy *proxy, pthread_mutex_t *proxy_mutex);
+
+    size_t size();
+    // whether [addr, addr + len) lies inside the host's RAM
+    bool contains(uint64_t addr, uint64_t len);
+    uint8_t *at(uint32_t addr);
+
+    // called from the indication thread
+    void read(uint8_t tag, uint32_t addr);
+    void write(uint32_t addr, const uint32_t *data);
+
+private:
+    BridgeRequestProxy *proxy;
+    pthread_mutex_t *proxy_mutex;
+    uint8_t *mem;
+    size_t mem_size;
+};
+
+#endif
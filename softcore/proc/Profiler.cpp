@@ -0,0 +1,93 @@
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Profiler.hpp"
+
+// Number of individual instructions listed in the flat profile
+#define HOT_PCS 20
+
+Profiler::Profiler() : total(0), dropped(0) {
+    pthread_mutex_init(&mutex, nullptr);
+}
+
+void Profiler::addSamples(const uint32_t *pcs, size_t len, uint32_t dropped) {
+    pthread_mutex_lock(&mutex);
+    for (size_t i = 0; i < len; i++) {
+        histogram[pcs[i]]++;
+    }
+    total += len;
+    this->dropped += dropped;
+    pthread_mutex_unlock(&mutex);
+}
+
+// Returns the function containing pc and the offset into it, or "[unknown]"
+static std::pair<std::string, uint32_t> symbolize(
+        const std::vector<ElfFile::Symbol> &symbols, uint32_t pc) {
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), pc,
+        [](uint32_t pc, const ElfFile::Symbol &s) { return pc < s.addr; });
+    if (it == symbols.begin()) {
+        return std::make_pair(std::string("[unknown]"), pc);
+    }
+    --it;
+    // symbols without a size (e.g. from assembly) extend up to the next one
+    if (it->size != 0 && pc >= it->addr + it->size) {
+        return std::make_pair(std::string("[unknown]"), pc);
+    }
+    return std::make_pair(it->name, (uint32_t)(pc - it->addr));
+}
+
+bool Profiler::report(const char *prefix, uint32_t interval, ElfFile *elf) {
+    std::vector<ElfFile::Symbol> no_symbols;
+    const std::vector<ElfFile::Symbol> &symbols = elf ? elf->getSymbols() : no_symbols;
+
+    pthread_mutex_lock(&mutex);
+    std::vector<std::pair<uint64_t, uint32_t>> pcs;
+    for (const auto &entry : histogram) {
+        pcs.push_back(std::make_pair(entry.second, entry.first));
+    }
+    uint64_t samples = total;
+    uint64_t lost = dropped;
+    pthread_mutex_unlock(&mutex);
+
+    std::sort(pcs.rbegin(), pcs.rend());
+    std::map<std::string, uint64_t> functions;
+    for (const auto &entry : pcs) {
+        functions[symbolize(symbols, entry.second).first] += entry.first;
+    }
+    std::vector<std::pair<uint64_t, std::string>> flat;
+    for (const auto &entry : functions) {
+        flat.push_back(std::make_pair(entry.second, entry.first));
+    }
+    std::sort(flat.rbegin(), flat.rend());
+
+    std::string flat_path = std::string(prefix) + ".flat";
+    FILE *f = fopen(flat_path.c_str(), "w");
+    if (!f) {
+        perror("ERROR: Profiler::report(): failed opening flat profile");
+        return false;
+    }
+    fprintf(f, "# %llu samples every %u cycles, %llu dropped\n",
+            (unsigned long long)samples, interval, (unsigned long long)lost);
+    fprintf(f, "#      %%    samples  function\n");
+    for (const auto &entry : flat) {
+        fprintf(f, "%8.2f %10llu  %s\n", 100.0 * entry.first / (samples ? samples : 1),
+                (unsigned long long)entry.first, entry.second.c_str());
+    }
+    fprintf(f, "\n# hottest instructions\n");
+    fprintf(f, "#      %%    samples  pc          location\n");
+    for (size_t i = 0; i < pcs.size() && i < HOT_PCS; i++) {
+        auto sym = symbolize(symbols, pcs[i].second);
+        fprintf(f, "%8.2f %10llu  0x%08x  %s+0x%x\n", 100.0 * pcs[i].first / (samples ? samples : 1),
+                (unsigned long long)pcs[i].first, pcs[i].second, sym.first.c_str(), sym.second);
+    }
+    fclose(f);
+
+    fprintf(stderr, "[Info] Profile of %llu samples written to %s\n",
+            (unsigned long long)samples, flat_path.c_str());
+    return true;
+}
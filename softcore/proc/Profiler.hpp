@@ -0,0 +1,38 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_map>
+
+#include "elf2hex/ElfFile.hpp"
+
+// Host side of the softcore's sampling profiler.
+//
+// The controller samples the pc of the last retired instruction every
+// interval cycles and sends the samples in bursts; they are accumulated into
+// a per-pc histogram here. At the end of a run the histogram is symbolized
+// with the guest ELF's function symbols and written out as a flat profile.
+// Only the sampled pc is known and not its callers, so there are no call
+// stacks to build a flame graph from.
+class Profiler {
+public:
+    Profiler();
+
+    // called from the indication thread
+    void addSamples(const uint32_t *pcs, size_t len, uint32_t dropped);
+
+    // writes PREFIX.flat; elf may be null, in which case
+    // samples are reported by address
+    bool report(const char *prefix, uint32_t interval, ElfFile *elf);
+
+private:
+    pthread_mutex_t mutex;
+    std::unordered_map<uint32_t, uint64_t> histogram;
+    uint64_t total;
+    uint64_t dropped;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <stddef.h>
+
+#include <atomic>
+
+#define CACHE_LINE 64
+
+// Single-producer/single-consumer ring buffer for the UART receive path.
+// Input is queued by the console and drained into the controller's RX FIFO,
+// head and tail are plain atomics instead of a mutex. They sit on separate
+// cache lines so that the two sides do not bounce each other's line.
+class RingBuffer {
+public:
+    RingBuffer() : head(0), tail(0) {}
+    // Enqueue up to len bytes, returns how many actually fit.
+    size_t enq(const char *buf, size_t len) {
+        unsigned int t = tail.load(std::memory_order_relaxed);
+        size_t free = room();
+        if (len > free) {
+            len = free;
+        }
+        for (size_t i = 0; i < len; i++) {
+            data[(t + i) & (SIZE - 1)] = buf[i];
+        }
+        tail.store(t + len, std::memory_order_release);
+        return len;
+    }
+    bool try_deq(char *c) {
+        unsigned int h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        *c = data[h & (SIZE - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    bool empty() {
+        return head.load(std::memory_order_acquire)
+               == tail.load(std::memory_order_acquire);
+    }
+    size_t room() {
+        return SIZE
+               - (tail.load(std::memory_order_acquire)
+                  - head.load(std::memory_order_acquire));
+    }
+
+    static const unsigned int SIZE = 1024; // must be a power of two
+
+private:
+    alignas(CACHE_LINE) std::atomic<unsigned int> head;
+    alignas(CACHE_LINE) std::atomic<unsigned int> tail;
+    char data[SIZE];
+};
+
+#endif
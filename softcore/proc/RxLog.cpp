@@ -0,0 +1,94 @@
+#include <inttypes.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "RxLog.hpp"
+
+RxLog::RxLog()
+    : proxy(nullptr), proxy_mutex(nullptr), record_file(nullptr),
+      replay_mode(false), sent(0), end_sent(false), replayed(0),
+      diverged(false) {
+    event_fd = eventfd(0, EFD_NONBLOCK);
+}
+
+bool RxLog::openRecord(const char *path) {
+    record_file = fopen(path, "w");
+    if (!record_file) {
+        perror("ERROR: RxLog::openRecord(): failed opening recording");
+        return false;
+    }
+    return true;
+}
+
+bool RxLog::openReplay(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror("ERROR: RxLog::openReplay(): failed opening recording");
+        return false;
+    }
+    uint64_t cycle;
+    unsigned int data;
+    int n;
+    while ((n = fscanf(f, "%" SCNu64 " %x", &cycle, &data)) == 2) {
+        replay.push_back(std::make_pair(cycle, (uint8_t)data));
+    }
+    bool ok = n == EOF && !ferror(f);
+    fclose(f);
+    if (!ok) {
+        fprintf(stderr, "ERROR: RxLog::openReplay(): malformed line %zu in %s\n",
+                replay.size() + 1, path);
+        return false;
+    }
+    replay_mode = true;
+    fprintf(stderr, "[Info] Replaying %zu UART bytes from %s\n", replay.size(), path);
+    return true;
+}
+
+RxLog::Mode RxLog::mode() {
+    return replay_mode ? REPLAY : record_file ? RECORD : LIVE;
+}
+
+void RxLog::setProxy(BridgeRequestProxy *proxy, pthread_mutex_t *proxy_mutex) {
+    this->proxy = proxy;
+    this->proxy_mutex = proxy_mutex;
+}
+
+int RxLog::eventFd() {
+    return event_fd;
+}
+
+void RxLog::consumed(uint64_t cycle, uint8_t data) {
+    if (record_file) {
+        fprintf(record_file, "%" PRIu64 " %02x\n", cycle, data);
+    }
+    if (replay_mode) {
+        size_t i = replayed++;
+        if (!diverged && (i >= replay.size() || replay[i].second != data)) {
+            fprintf(stderr, "[Warning] UART replay diverged at byte %zu\n", i);
+            diverged = true;
+        }
+        eventfd_write(event_fd, 1);
+    }
+}
+
+void RxLog::refill() {
+    eventfd_t v;
+    eventfd_read(event_fd, &v);
+    pthread_mutex_lock(proxy_mutex);
+    while (sent < replay.size() && sent - replayed < RX_DEPTH) {
+        proxy->uartRx(replay[sent].first, replay[sent].second);
+        sent++;
+    }
+    if (sent == replay.size() && !end_sent) {
+        proxy->uartReplayEnd();
+        end_sent = true;
+    }
+    pthread_mutex_unlock(proxy_mutex);
+}
+
+void RxLog::close() {
+    if (record_file) {
+        fclose(record_file);
+        record_file = nullptr;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef RX_LOG_HPP
+#define RX_LOG_HPP
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "BridgeRequest.h"
+
+// Record and replay of the guest's UART input.
+//
+// A recording lists every byte the guest read together with the cycle at
+// which the guest first saw it available, one "cycle byte" pair per line.
+// On replay the controller's RX FIFO is filled with such pairs, and each
+// byte becomes available at its recorded cycle, so input arrives at the same
+// cycles in every run regardless of host timing.
+class RxLog {
+public:
+    // must match UartRxDepth in Controller.bsv
+    static const size_t RX_DEPTH = 32;
+    // in the order of UartMode in Controller.bsv
+    enum Mode { LIVE, RECORD, REPLAY };
+
+    RxLog();
+    bool openRecord(const char *path);
+    bool openReplay(const char *path);
+    Mode mode();
+    void setProxy(BridgeRequestProxy *proxy, pthread_mutex_t *proxy_mutex);
+
+    // called from the indication thread for every byte the guest consumed
+    void consumed(uint64_t cycle, uint8_t data);
+
+    // readable when replay credits were returned, then call refill()
+    int eventFd();
+    // send as many replay bytes as the controller has room for
+    void refill();
+    void close();
+
+private:
+    BridgeRequestProxy *proxy;
+    pthread_mutex_t *proxy_mutex;
+    FILE *record_file;
+    bool replay_mode;
+    int event_fd;
+
+    std::vector<std::pair<uint64_t, uint8_t>> replay;
+    size_t sent;
+    bool end_sent;
+    std::atomic<size_t> replayed;
+    bool diverged;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "Stats.hpp"
+
+// in the order of sendCounters in Controller.bsv
+enum {
+    CYCLES,
+    INSTRET,
+    IFETCHES,
+    LOADS,
+    STORES,
+    MMIO,
+    STALL_RAW,
+    STALL_WAW,
+    REDIRECTS,
+    SQUASHES,
+    IC_HITS,
+    IC_MISSES,
+    DC_HITS,
+    DC_MISSES,
+    DC_WRITEBACKS,
+    BRANCHES,
+    BRANCH_MISSES,
+    JUMPS,
+    RETURNS,
+    RETURN_MISSES,
+    STALL_FULL,
+    JUMP_MISSES,
+};
+
+static const char *counter_names[Stats::NUM_COUNTERS] = {
+    "cycles",
+    "instret",
+    "ifetches",
+    "loads",
+    "stores",
+    "mmio",
+    "stall_raw",
+    "stall_waw",
+    "redirects",
+    "squashes",
+    "ic_hits",
+    "ic_misses",
+    "dc_hits",
+    "dc_misses",
+    "dc_wbacks",
+    "branches",
+    "br_misses",
+    "jumps",
+    "returns",
+    "ret_misses",
+    "stall_full",
+    "jmp_misses",
+};
+
+Stats::Stats() : out(stderr), generation(0) {
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&cond, nullptr);
+    memset(prev, 0, sizeof(prev));
+}
+
+bool Stats::open(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror("ERROR: Stats::open(): failed opening stats output");
+        return false;
+    }
+    out = f;
+    return true;
+}
+
+void Stats::close() {
+    pthread_mutex_lock(&mutex);
+    if (out != stderr) {
+        fclose(out);
+        out = stderr;
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+static double ratio(uint64_t a, uint64_t b) {
+    return b ? (double)a / b : 0.0;
+}
+
+void Stats::print(const uint64_t *values, const uint64_t *prev) {
+    uint64_t delta[NUM_COUNTERS];
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        delta[i] = values[i] - prev[i];
+    }
+    fprintf(out, "[Stats] %-10s %16s %14s\n", "counter", "total", "interval");
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        fprintf(out, "[Stats] %-10s %16llu %14llu\n", counter_names[i],
+                (unsigned long long)values[i], (unsigned long long)delta[i]);
+    }
+    fprintf(out, "[Stats] CPI %.3f (%.3f), stalls raw %.1f%% waw %.1f%% full %.1f%% of cycles, "
+            "%.1f squashes per redirect\n",
+            ratio(values[CYCLES], values[INSTRET]), ratio(delta[CYCLES], delta[INSTRET]),
+            100.0 * ratio(delta[STALL_RAW], delta[CYCLES]),
+            100.0 * ratio(delta[STALL_WAW], delta[CYCLES]),
+            100.0 * ratio(delta[STALL_FULL], delta[CYCLES]),
+            ratio(delta[SQUASHES], delta[REDIRECTS]));
+    fprintf(out, "[Stats] I$ miss rate %.2f%%, D$ miss rate %.2f%%, %.1f%% of D$ misses wrote back\n",
+            100.0 * ratio(delta[IC_MISSES], delta[IC_HITS] + delta[IC_MISSES]),
+            100.0 * ratio(delta[DC_MISSES], delta[DC_HITS] + delta[DC_MISSES]),
+            100.0 * ratio(delta[DC_WRITEBACKS], delta[DC_MISSES]));
+    fprintf(out, "[Stats] branch mispredict rate %.2f%%, jump mispredict rate %.2f%%, "
+            "return mispredict rate %.2f%%\n",
+            100.0 * ratio(delta[BRANCH_MISSES], delta[BRANCHES]),
+            100.0 * ratio(delta[JUMP_MISSES], delta[JUMPS]),
+            100.0 * ratio(delta[RETURN_MISSES], delta[RETURNS]));
+    fflush(out);
+}
+
+void Stats::update(const uint64_t *values) {
+    pthread_mutex_lock(&mutex);
+    print(values, prev);
+    memcpy(prev, values, sizeof(prev));
+    generation++;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+uint64_t Stats::snapshots() {
+    pthread_mutex_lock(&mutex);
+    uint64_t count = generation;
+    pthread_mutex_unlock(&mutex);
+    return count;
+}
+
+bool Stats::waitForSnapshot(uint64_t count, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&mutex);
+    int err = 0;
+    while (generation <= count && err != ETIMEDOUT) {
+        err = pthread_cond_timedwait(&cond, &mutex, &deadline);
+    }
+    bool updated = generation > count;
+    pthread_mutex_unlock(&mutex);
+    return updated;
+}
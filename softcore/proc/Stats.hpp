@@ -0,0 +1,40 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Host side of the softcore's performance counters.
+//
+// Snapshots of all counters arrive through the counterValues indication; each
+// one is printed together with the change since the previous snapshot, so
+// that CPI and stall breakdowns can be followed over a long run.
+class Stats {
+public:
+    // must match NumCounters in Controller.bsv
+    static const int NUM_COUNTERS = 22;
+
+    Stats();
+    // print the snapshots to path instead of stderr
+    bool open(const char *path);
+    void close();
+
+    // called from the indication thread
+    void update(const uint64_t *values);
+    // number of snapshots received so far
+    uint64_t snapshots();
+    // block until more than count snapshots were received, or timeout
+    bool waitForSnapshot(uint64_t count, int timeout_ms);
+
+private:
+    void print(const uint64_t *values, const uint64_t *prev);
+
+    FILE *out;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint64_t generation;
+    uint64_t prev[NUM_COUNTERS];
+};
+
+#endif
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Build every core and compare them on the test programs.
+
+Each core is built from scratch with `make build.verilator CORE=<core>`, and
+its simulator is kept under --out/<core>/bin so that the next build does not
+overwrite it. The tests then run on every core as with run_tests.py. The
+cycles, CPI and simulation wall time of every test are printed side by side
+and written as JSON to --report.
+"""
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import time
+
+import run_tests
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+CORES = ["multicycle", "pipelined", "pipelined2", "superscalar", "ooo"]
+
+
+def build(core, out):
+    # connectal does not rebuild when only CORE changed
+    shutil.rmtree(os.path.join(HERE, "verilator"), ignore_errors=True)
+    subprocess.check_call(["make", "-C", os.path.join(HERE, ".."), "build.verilator",
+                           "CORE=" + core])
+    bin_dir = os.path.join(out, core, "bin")
+    shutil.rmtree(bin_dir, ignore_errors=True)
+    shutil.copytree(os.path.join(HERE, "verilator", "bin"), bin_dir)
+    return os.path.join(bin_dir, "ubuntu.exe")
+
+
+def fmt(value, spec):
+    return spec % value if value is not None else "-"
+
+
+def print_table(cores, tests, results):
+    print()
+    print("%-16s" % "test" + "".join(" %38s" % core for core in cores))
+    print("%-16s" % "" + " %14s %8s %14s" % ("cycles", "CPI", "seconds") * len(cores))
+    for test in tests:
+        line = "%-16s" % test
+        for core in cores:
+            r = results[core][test]
+            cycles = fmt(r["cycles"], "%d") if r["status"] == "pass" else r["status"].upper()
+            line += " %14s %8s %14s" % (cycles, fmt(r["cpi"], "%.3f"), fmt(r["seconds"], "%.1f"))
+        print(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("tests", nargs="*",
+                        help="tests to run, e.g. add32 (default: every .hex in --build)")
+    parser.add_argument("--cores", default=",".join(CORES),
+                        help="comma-separated cores to compare (default: %(default)s)")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count(),
+                        help="simulations to run at once (default: %(default)s)")
+    parser.add_argument("--build", default=os.path.join(HERE, "test", "build"),
+                        help="directory with the test images (default: %(default)s)")
+    parser.add_argument("--out", default=os.path.join(HERE, "bench_runs"),
+                        help="simulators and per-test working directories (default: %(default)s)")
+    parser.add_argument("--report", default="bench_report.json",
+                        help="JSON report (default: %(default)s)")
+    parser.add_argument("--timeout", type=int, default=300,
+                        help="wall-clock seconds before a test is stopped (default: %(default)s)")
+    parser.add_argument("--max-cycles", type=int, default=0,
+                        help="cycles before a test is stopped (default: no limit)")
+    parser.add_argument("--run-args", default="",
+                        help="extra arguments for the bridge")
+    parser.add_argument("--no-build", action="store_true",
+                        help="reuse the simulators from a previous run in --out")
+    args = parser.parse_args()
+    args.out = os.path.abspath(args.out)
+    args.run_args = args.run_args.split()
+    cores = args.cores.split(",")
+    unknown = [c for c in cores if c not in CORES]
+    if unknown:
+        sys.exit("ERROR: unknown core %s, choose from %s" % (", ".join(unknown), ", ".join(CORES)))
+
+    tests = args.tests or run_tests.find_tests(args.build)
+    missing = [t for t in tests if not os.path.exists(os.path.join(args.build, t + ".hex"))]
+    if missing:
+        sys.exit("ERROR: no image for %s in %s, run `make -C test` first"
+                 % (", ".join(missing), args.build))
+
+    start = time.monotonic()
+    results = {}
+    for core in cores:
+        if args.no_build:
+            args.exe = os.path.join(args.out, core, "bin", "ubuntu.exe")
+        else:
+            args.exe = build(core, args.out)
+        core_args = argparse.Namespace(**vars(args))
+        core_args.out = os.path.join(args.out, core, "runs")
+        print("== %s" % core)
+        sys.stdout.flush()
+        results[core] = {r["test"]: r for r in run_tests.run_suite(tests, core_args)}
+    elapsed = time.monotonic() - start
+
+    print_table(cores, tests, results)
+    with open(args.report, "w") as f:
+        json.dump({"seconds": round(elapsed, 3),
+                   "cores": {core: [results[core][t] for t in tests] for core in cores}},
+                  f, indent=2)
+        f.write("\n")
+    passed = all(r["status"] == "pass" for core in cores for r in results[core].values())
+    print("%s in %.1f s, report in %s" % ("all passed" if passed else "FAILURES", elapsed,
+                                          args.report))
+    return 0 if passed else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
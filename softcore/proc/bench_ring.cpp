@@ -0,0 +1,158 @@
+// Microbenchmark of the UART receive queue: the SPSC RingBuffer against the
+// mutex-protected Buffer that bridge.cpp used before it.
+//
+// Throughput: one thread enqueues BYTES bytes, another dequeues and checks
+// them. Poll latency: the consumer spins on the queue, the producer enqueues
+// one byte and waits for it to be echoed back through a second queue of the
+// same kind; half the round trip is reported. Waiting sides spin, and yield
+// now and then so that the benchmark also works on a single CPU.
+//
+//     make bench_ring && ./bench_ring
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "RingBuffer.hpp"
+
+static const long BYTES = 20000000;
+static const int PINGS = 100000;
+
+// The previous receive buffer, with the index wrap fixed and the blocking
+// deq() replaced by the try_deq() the event loop polls with
+class MutexBuffer {
+public:
+    MutexBuffer() : head(0), count(0) {
+        pthread_mutex_init(&mutex, nullptr);
+    }
+    size_t enq(const char *buf, size_t len) {
+        pthread_mutex_lock(&mutex);
+        size_t n = 0;
+        for (; n < len && count < SIZE; n++) {
+            data[(head + count) % SIZE] = buf[n];
+            count++;
+        }
+        pthread_mutex_unlock(&mutex);
+        return n;
+    }
+    bool try_deq(char *c) {
+        pthread_mutex_lock(&mutex);
+        bool ok = count > 0;
+        if (ok) {
+            *c = data[head];
+            head = (head + 1) % SIZE;
+            count--;
+        }
+        pthread_mutex_unlock(&mutex);
+        return ok;
+    }
+
+    static const unsigned int SIZE = 1024;
+
+private:
+    unsigned int head;
+    unsigned int count;
+    char data[SIZE];
+    pthread_mutex_t mutex;
+};
+
+// Busy-wait, but let the other side run when it shares our CPU
+static void relax(int &spins) {
+    if (++spins >= 1000) {
+        sched_yield();
+        spins = 0;
+    }
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <class Q>
+struct Pair {
+    Q to;
+    Q back;
+};
+
+template <class Q>
+static void *produce(void *arg) {
+    Q *q = (Q *)arg;
+    char buf[64];
+    for (long sent = 0; sent < BYTES; ) {
+        long len = BYTES - sent < 64 ? BYTES - sent : 64;
+        for (long i = 0; i < len; i++) {
+            buf[i] = (char)(sent + i);
+        }
+        int spins = 0;
+        for (size_t done = 0; done < (size_t)len; relax(spins)) {
+            done += q->enq(buf + done, len - done);
+        }
+        sent += len;
+    }
+    return nullptr;
+}
+
+template <class Q>
+static double throughput() {
+    static Q q;
+    pthread_t thread;
+    auto start = std::chrono::steady_clock::now();
+    pthread_create(&thread, nullptr, produce<Q>, &q);
+    for (long i = 0; i < BYTES; i++) {
+        char c;
+        for (int spins = 0; !q.try_deq(&c); relax(spins)) {
+        }
+        if (c != (char)i) {
+            fprintf(stderr, "ERROR: byte %ld out of order\n", i);
+            exit(1);
+        }
+    }
+    pthread_join(thread, nullptr);
+    double s = seconds_since(start);
+    return BYTES / s;
+}
+
+template <class Q>
+static void *echo(void *arg) {
+    Pair<Q> *p = (Pair<Q> *)arg;
+    for (int i = 0; i < PINGS; i++) {
+        char c;
+        for (int spins = 0; !p->to.try_deq(&c); relax(spins)) {
+        }
+        for (int spins = 0; p->back.enq(&c, 1) == 0; relax(spins)) {
+        }
+    }
+    return nullptr;
+}
+
+// median one-way latency in nanoseconds
+template <class Q>
+static double latency() {
+    static Pair<Q> p;
+    pthread_t thread;
+    pthread_create(&thread, nullptr, echo<Q>, &p);
+    std::vector<double> ns;
+    for (int i = 0; i < PINGS; i++) {
+        char c = (char)i;
+        auto start = std::chrono::steady_clock::now();
+        p.to.enq(&c, 1);
+        for (int spins = 0; !p.back.try_deq(&c); relax(spins)) {
+        }
+        ns.push_back(seconds_since(start) * 1e9 / 2);
+    }
+    pthread_join(thread, nullptr);
+    std::nth_element(ns.begin(), ns.begin() + ns.size() / 2, ns.end());
+    return ns[ns.size() / 2];
+}
+
+int main() {
+    printf("%-12s %14s %16s\n", "queue", "MB/s", "poll latency ns");
+    printf("%-12s %14.1f %16.0f\n", "mutex", throughput<MutexBuffer>() / 1e6, latency<MutexBuffer>());
+    printf("%-12s %14.1f %16.0f\n", "spsc ring", throughput<RingBuffer>() / 1e6, latency<RingBuffer>());
+    return 0;
+}
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Measure what coalescing UART output into bursts saves on a boot log.
+
+Runs the guest once per burst size with `--uart-burst`, for the same number
+of cycles, and compares the wall time of the runs. With a burst size of 1
+every output byte costs the host one indication, as before output was
+coalesced. The default guest is mini-rv32ima booting Linux, whose boot log
+is written by the guest byte by byte. Every run is headless, with its
+console output written to its own directory under --out.
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+GUEST = os.path.join(HERE, "..", "..", "guest")
+STOP_RE = re.compile(r"^(?:Finish: -?\d+|Cycle limit reached) after (\d+) cycles$", re.MULTILINE)
+
+
+def run(burst, args):
+    work_dir = os.path.join(args.out, "burst%d" % burst)
+    os.makedirs(work_dir, exist_ok=True)
+    env = dict(os.environ, BLUESIM_SOCKET_NAME=os.path.join(work_dir, "socket"))
+    cmd = [args.exe, "--headless", "--max-cycles", str(args.max_cycles),
+           "--uart-burst", str(burst), "--elf", args.elf] + args.run_args
+    log_path = os.path.join(work_dir, "output.log")
+    start = time.monotonic()
+    with open(log_path, "w") as log:
+        subprocess.call(cmd, cwd=work_dir, env=env, stdin=subprocess.DEVNULL,
+                        stdout=log, stderr=subprocess.STDOUT)
+    seconds = time.monotonic() - start
+    with open(log_path, "rb") as log:
+        output = log.read()
+    match = STOP_RE.search(output.decode(errors="replace"))
+    return {"burst": burst, "seconds": seconds, "bytes": len(output),
+            "cycles": int(match.group(1)) if match else None}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--exe", default=os.path.join(HERE, "verilator", "bin", "ubuntu.exe"),
+                        help="simulator (default: %(default)s)")
+    parser.add_argument("--elf", default=os.path.join(GUEST, "mini-rv32ima"),
+                        help="guest (default: %(default)s)")
+    parser.add_argument("--bursts", default="1,8",
+                        help="comma-separated burst sizes, the first is the reference (default: %(default)s)")
+    parser.add_argument("--max-cycles", type=int, default=50000000,
+                        help="cycles every run is stopped after (default: %(default)s)")
+    parser.add_argument("--out", default=os.path.join(HERE, "bench_runs", "uart"),
+                        help="per-run working directories (default: %(default)s)")
+    parser.add_argument("--run-args", default="--dram 256",
+                        help="extra arguments for the bridge (default: %(default)s)")
+    args = parser.parse_args()
+    args.out = os.path.abspath(args.out)
+    args.elf = os.path.abspath(args.elf)
+    args.run_args = args.run_args.split()
+    if not os.path.exists(args.exe):
+        sys.exit("ERROR: no simulator at %s, run `make build.verilator` first" % args.exe)
+
+    results = [run(int(b), args) for b in args.bursts.split(",")]
+    print("%6s %14s %10s %10s %8s" % ("burst", "cycles", "out bytes", "seconds", "speedup"))
+    for r in results:
+        cycles = "%d" % r["cycles"] if r["cycles"] is not None else "-"
+        print("%6d %14s %10d %10.1f %7.2fx" % (r["burst"], cycles, r["bytes"], r["seconds"],
+                                               results[0]["seconds"] / r["seconds"]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,178 @@
+// Host side of coalescing UART output: what a boot log costs the bridge with
+// one indication per byte against bursts of up to 8 bytes.
+//
+// The log is cut into bursts the way uartTxDrain in Controller.bsv does, a
+// burst ends when it is full or after a newline. Every burst is sent as one
+// message over a socket pair, standing in for connectal's transport, to the
+// thread that plays the indication thread and hands it to Console::write().
+// An event loop thread serves the stdio console as bridge.cpp does, with
+// stdout redirected to /dev/null. The simulated core is not part of this, so
+// the result is the host's share of the saving only.
+//
+//     make bench_uart_host && dmesg > boot.log && ./bench_uart_host boot.log
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Console.hpp"
+#include "RingBuffer.hpp"
+
+// the log is repeated up to at least this many bytes for a stable timing
+static const size_t MIN_BYTES = 4 << 20;
+static const int BURST_MAX = 8;
+
+// uartTxBurst's arguments
+struct Burst {
+    uint8_t len;
+    uint8_t data[BURST_MAX];
+};
+
+static RingBuffer rx;
+static Console console(rx);
+static std::atomic<bool> stop(false);
+
+static void *event_loop(void *arg) {
+    int epfd = *(int *)arg;
+    while (!stop) {
+        struct epoll_event events[16];
+        int n = epoll_wait(epfd, events, 16, 10);
+        for (int i = 0; i < n; i++) {
+            console.handle(events[i].data.fd, events[i].events);
+        }
+    }
+    return nullptr;
+}
+
+struct Sender {
+    int fd;
+    const std::vector<Burst> *bursts;
+};
+
+static void *send_bursts(void *arg) {
+    Sender *s = (Sender *)arg;
+    for (const Burst &b : *s->bursts) {
+        if (write(s->fd, &b, sizeof(b)) != sizeof(b)) {
+            perror("ERROR: write");
+            exit(1);
+        }
+    }
+    return nullptr;
+}
+
+static std::vector<Burst> cut(const std::string &log, int burst_max) {
+    std::vector<Burst> bursts;
+    Burst b;
+    b.len = 0;
+    for (char c : log) {
+        b.data[b.len++] = (uint8_t)c;
+        if (b.len == burst_max || c == '\n') {
+            bursts.push_back(b);
+            b.len = 0;
+        }
+    }
+    if (b.len != 0) {
+        bursts.push_back(b);
+    }
+    return bursts;
+}
+
+// seconds to deliver all bursts to the console
+static double run(const std::vector<Burst> &bursts) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        perror("ERROR: socketpair");
+        exit(1);
+    }
+    Sender sender = {fds[0], &bursts};
+    pthread_t thread;
+    auto start = std::chrono::steady_clock::now();
+    pthread_create(&thread, nullptr, send_bursts, &sender);
+    for (size_t i = 0; i < bursts.size(); i++) {
+        Burst b;
+        for (size_t got = 0; got < sizeof(b); ) {
+            ssize_t n = read(fds[1], (char *)&b + got, sizeof(b) - got);
+            if (n <= 0) {
+                perror("ERROR: read");
+                exit(1);
+            }
+            got += n;
+        }
+        console.write(b.data, b.len);
+    }
+    console.flush();
+    pthread_join(thread, nullptr);
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    close(fds[0]);
+    close(fds[1]);
+    return s;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s BOOT_LOG\n", argv[0]);
+        return 1;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror("ERROR: fopen");
+        return 1;
+    }
+    std::string one;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        one.append(buf, n);
+    }
+    fclose(f);
+    if (one.empty()) {
+        fprintf(stderr, "ERROR: %s is empty\n", argv[1]);
+        return 1;
+    }
+    std::string log;
+    while (log.size() < MIN_BYTES) {
+        log += one;
+    }
+
+    // the console writes to stdout, the results go to the original one
+    FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+    int null_fd = open("/dev/null", O_RDWR);
+    dup2(null_fd, STDOUT_FILENO);
+    dup2(null_fd, STDIN_FILENO);
+    console.open("stdio");
+    int epfd = epoll_create1(0);
+    console.attach(epfd);
+    pthread_t loop;
+    pthread_create(&loop, nullptr, event_loop, &epfd);
+
+    fprintf(out, "%zu bytes, %zu lines\n", log.size(),
+            (size_t)std::count(log.begin(), log.end(), '\n'));
+    fprintf(out, "%6s %12s %10s %12s %8s\n", "burst", "indications", "seconds", "ns per byte",
+            "speedup");
+    double first = 0;
+    for (int burst : {1, BURST_MAX}) {
+        std::vector<Burst> bursts = cut(log, burst);
+        double s = run(bursts);
+        if (first == 0) {
+            first = s;
+        }
+        fprintf(out, "%6d %12zu %10.3f %12.1f %7.2fx\n", burst, bursts.size(), s,
+                s * 1e9 / log.size(), first / s);
+    }
+
+    stop = true;
+    pthread_join(loop, nullptr);
+    console.close();
+    return 0;
+}
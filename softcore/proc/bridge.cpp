@@ -1,130 +1,511 @@
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "BridgeIndication.h"
 #include "BridgeRequest.h"
 #include "GeneratedTypes.h"
 #include <time.h>
+#include <getopt.h>
 #include <pthread.h>
-#include <semaphore.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include "BlockDevice.hpp"
+#include "Checkpoint.hpp"
+#include "Console.hpp"
+#include "Dram.hpp"
+#include "Profiler.hpp"
+#include "RingBuffer.hpp"
+#include "RxLog.hpp"
+#include "Stats.hpp"
+#include "elf2hex/ElfFile.hpp"
 
-#define POS_MOD(a, b) ((a) % (b) + (b)) % (b)
+// Pending UART output is flushed at the latest after this many microseconds
+#define TX_FLUSH_US 10000
+// Default period of the host timer tick that drives the softcore's mtime
+#define TIMER_TICK_US 1000
+// Exit code when the run is stopped by --max-cycles or --timeout, as timeout(1)
+#define BUDGET_EXIT_CODE 124
+// Words per memWrite request, must match MemBurstLen in Controller.bsv
+#define MEM_BURST_LEN 16
+// Bytes per uartTxBurst indication, must match UartBurstLen in Controller.bsv
+#define UART_BURST_LEN 8
 
 int ret_code = 0xdeadbeef;
+static uint64_t finish_cycles;
+static bool cycle_limit_hit = false;
+static bool time_limit_hit = false;
 
 static BridgeRequestProxy *bridgeRequestProxy = nullptr;
-static sem_t sem_finish;
 
-class Buffer {
-public:
-    Buffer() : count(0), head(0) {
-        data = new char[SIZE];
-        sem_init(&can_read, 0, 0);
-        pthread_mutex_init(&mutex, nullptr);
-    }
-    ~Buffer() {
-        delete [] data;
-    }
-    void enq(char c) {
-        pthread_mutex_lock(&mutex);
-        if (count < SIZE) {
-            // printf("Enq at %d, %x %c;\n", head + count, c, c);
-            data[head + count] = c;
-            count++;
-            sem_post(&can_read);
-        } else {
-            printf("Buffer full\n");
-        }
-        pthread_mutex_unlock(&mutex);
-    }
-    char deq() {
-        pthread_mutex_lock(&mutex);
-        if (count > 0) {
-            count--;
-            char c = data[head];
-            // printf("Deq at %d, %x %c;\n", head, c, c);
-            head = POS_MOD(head + 1, SIZE);
-            pthread_mutex_unlock(&mutex);
-            return c;
-        } else {
-            // wait to return something
-            pthread_mutex_unlock(&mutex);
-            sem_wait(&can_read);
-            return deq();
-        }
-    }
-    bool empty() {
-        pthread_mutex_lock(&mutex);
-        bool res = count == 0;
-        pthread_mutex_unlock(&mutex);
-        return res;
-    }
-    volatile unsigned int head;
-    volatile unsigned int count;
-    volatile char * data;
-
-    pthread_mutex_t mutex;
-
-    sem_t can_read;
-
-    static const int SIZE = 1024;
-};
+static RingBuffer uart_buf;
+static Console console(uart_buf);
+static Profiler profiler;
+static Stats stats;
+static Dram dram;
+static Checkpoint checkpoint(dram);
+static BlockDevice blk(dram);
+static RxLog rx_log;
+static const char *checkpoint_path = "checkpoint.bin";
+static unsigned int stats_interval_s = 0;
+static unsigned int timer_tick_us = TIMER_TICK_US;
+// keep running after console EOF, only the guest or a budget ends the run
+static bool headless = false;
+static uint64_t deadline_us = 0;
 
-static Buffer * uart_buf;
+// eventfds used by the indication thread to wake up the event loop
+static int rx_credit_fd;
+static int finish_fd;
 
-void * handle_input(void * arg) {
-    while (true) {
-        char c = getchar();
-        if (c == EOF) {
-            return 0;
+// Proxy calls are issued from several threads
+static pthread_mutex_t proxy_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// live input is available to the guest as soon as it reaches the controller
+static void uart_rx(char c) {
+    pthread_mutex_lock(&proxy_mutex);
+    bridgeRequestProxy->uartRx(0, c);
+    pthread_mutex_unlock(&proxy_mutex);
+}
+
+static uint64_t monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Host event loop: serves the console and pushes its input into the
+// controller's RX FIFO while there is room, performs the block device's
+// transfers and takes a checkpoint on SIGUSR1.
+// Returns once the guest has finished, the cycle or time budget is used up,
+// or, unless headless, on EOF of the stdio console.
+static void event_loop() {
+    int epfd = epoll_create1(0);
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    int sig_fd = signalfd(-1, &mask, SFD_NONBLOCK);
+    int fds[] = {rx_credit_fd, finish_fd, sig_fd, checkpoint.eventFd(), rx_log.eventFd(),
+                 blk.eventFd()};
+    for (int fd : fds) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("epoll_ctl");
         }
-        uart_buf->enq(c);
     }
+    console.attach(epfd);
+
+    // free slots in the controller's RX FIFO; replayed input is sent by rx_log
+    uint64_t rx_credits = rx_log.mode() == RxLog::REPLAY ? 0 : RxLog::RX_DEPTH;
+    bool running = true;
+    while (running) {
+        struct epoll_event events[16];
+        int timeout_ms = -1;
+        if (deadline_us != 0) {
+            uint64_t now = monotonic_us();
+            if (now >= deadline_us) {
+                time_limit_hit = true;
+                break;
+            }
+            timeout_ms = (deadline_us - now + 999) / 1000;
+        }
+        int halt_ms = checkpoint.timeoutMs();
+        if (halt_ms >= 0 && (timeout_ms < 0 || halt_ms < timeout_ms)) {
+            timeout_ms = halt_ms;
+        }
+        int n = epoll_wait(epfd, events, 16, timeout_ms);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == rx_credit_fd) {
+                eventfd_t v;
+                if (eventfd_read(rx_credit_fd, &v) == 0) {
+                    rx_credits += v;
+                }
+            } else if (fd == finish_fd) {
+                running = false;
+            } else if (fd == sig_fd) {
+                struct signalfd_siginfo info;
+                while (read(sig_fd, &info, sizeof(info)) == sizeof(info)) {
+                    checkpoint.requestHalt();
+                }
+            } else if (fd == checkpoint.eventFd()) {
+                // the core has drained, save() refuses if the controller is
+                // not idle
+                checkpoint.save(checkpoint_path);
+            } else if (fd == rx_log.eventFd()) {
+                rx_log.refill();
+            } else if (fd == blk.eventFd()) {
+                blk.transfer();
+            } else if (!console.handle(fd, events[i].events) && !headless) {
+                running = false;
+            }
+        }
+
+        checkpoint.checkTimeout();
+
+        char c;
+        while (rx_credits > 0 && uart_buf.try_deq(&c)) {
+            uart_rx(c);
+            rx_credits--;
+        }
+        console.resumeInput();
+    }
+    console.close();
+    close(sig_fd);
+    close(epfd);
 }
 
+// Flush UART output that did not end in a newline once the guest goes quiet.
+void * handle_flush(void * arg) {
+    while (true) {
+        usleep(TX_FLUSH_US);
+        console.flush();
+    }
+}
+
+// Advance the softcore's mtime by the wall-clock time that actually passed,
+// so that sleep jitter does not make the guest's clock drift.
 void * handle_timer(void * arg) {
+    uint64_t last = monotonic_us();
+    while (true) {
+        usleep(timer_tick_us);
+        uint64_t now = monotonic_us();
+        pthread_mutex_lock(&proxy_mutex);
+        bridgeRequestProxy->timerTick(now - last);
+        pthread_mutex_unlock(&proxy_mutex);
+        last = now;
+    }
+}
+
+// Periodically ask the softcore for a snapshot of its performance counters.
+void * handle_stats(void * arg) {
     while (true) {
-        usleep(1000);
-        bridgeRequestProxy->timer_interrupt();
+        sleep(stats_interval_s);
+        // the main thread cancels us at exit, never while holding the mutex
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, nullptr);
+        pthread_mutex_lock(&proxy_mutex);
+        bridgeRequestProxy->readCounters();
+        pthread_mutex_unlock(&proxy_mutex);
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, nullptr);
+    }
+}
+
+// Write the ELF's loadable segments into the softcore's memory, zeroing what
+// is not backed by the file. Runs before the core is started, so the proxy
+// is not shared yet.
+static bool load_elf(ElfFile &elf) {
+    size_t loaded = 0;
+    uint64_t start = monotonic_us();
+    if (elf.getEntry() != 0) {
+        fprintf(stderr, "[Warning] ELF entry point 0x%llx ignored, the core starts at 0\n", elf.getEntry());
+    }
+    for (const ElfFile::Section &s : elf.getSections()) {
+        if (s.base % 4 != 0) {
+            fprintf(stderr, "ERROR: load_elf(): segment at 0x%llx is not word aligned\n", s.base);
+            return false;
+        }
+        if (dram.contains(s.base, s.section_size)) {
+            // the host's RAM starts out zeroed
+            memcpy(dram.at(s.base), s.data, s.data_size);
+            loaded += s.section_size;
+            continue;
+        }
+        if (dram.contains(s.base + s.section_size - 1, 1) || dram.contains(s.base, 1)) {
+            fprintf(stderr, "ERROR: load_elf(): segment at 0x%llx crosses the host RAM's bounds\n", s.base);
+            return false;
+        }
+        // the last word of the file data is padded with zeros
+        size_t data_words = (s.data_size + 3) / 4;
+        for (size_t i = 0; i < data_words; i += MEM_BURST_LEN) {
+            bsvvector_Luint32_t_L16 data;
+            memset(data, 0, sizeof(data));
+            size_t len = data_words - i < MEM_BURST_LEN ? data_words - i : MEM_BURST_LEN;
+            size_t bytes = s.data_size - i * 4 < len * 4 ? s.data_size - i * 4 : len * 4;
+            memcpy(data, s.data + i * 4, bytes);
+            bridgeRequestProxy->memWrite(s.base + i * 4, len, data);
+        }
+        size_t section_words = (s.section_size + 3) / 4;
+        if (section_words > data_words) {
+            bridgeRequestProxy->memZero(s.base + data_words * 4, section_words - data_words);
+        }
+        loaded += s.section_size;
     }
+    fprintf(stderr, "[Info] Loaded %zu bytes in %zu segments in %.1f ms\n", loaded,
+            elf.getSections().size(), (monotonic_us() - start) / 1000.0);
+    return true;
 }
 
 class BridgeIndication : public BridgeIndicationWrapper
 {
 public:
-    virtual void uartAvailReq() {
-        // printf("uartAvailReq\n");
-        bridgeRequestProxy->uartAvailResp(!uart_buf->empty());
+    virtual void uartTxBurst(const uint8_t len, const bsvvector_Luint8_t_L8 data) {
+        // the console flushes on line ends and leaves partial lines to the
+        // flush thread
+        console.write(data, len);
+    }
+
+    virtual void uartRxConsumed(const uint64_t cycle, const uint8_t data) {
+        rx_log.consumed(cycle, data);
+        // never block the indication thread, the event loop sends the next
+        // byte once one is available
+        if (rx_log.mode() != RxLog::REPLAY) {
+            eventfd_write(rx_credit_fd, 1);
+        }
+    }
+
+    virtual void pcSamples(const uint8_t len, const bsvvector_Luint32_t_L8 pcs, const uint32_t dropped) {
+        profiler.addSamples(pcs, len, dropped);
+    }
+
+    virtual void counterValues(const bsvvector_Luint64_t_L22 values) {
+        stats.update(values);
+    }
+
+    virtual void coreHalted(const uint32_t pc, const uint64_t mtime, const uint64_t mtimecmp,
+                            const uint64_t cycles, const uint8_t busy) {
+        checkpoint.halted(pc, mtime, mtimecmp, cycles, busy);
+    }
+
+    virtual void regValue(const uint8_t idx, const uint32_t data) {
+        checkpoint.regValue(idx, data);
+    }
+
+    virtual void memData(const uint32_t addr, const bsvvector_Luint32_t_L16 data) {
+        checkpoint.memData(addr, data);
+    }
+
+    virtual void memDumpDone() {
+        checkpoint.memDumpDone();
+    }
+
+    virtual void dramRead(const uint8_t tag, const uint32_t addr) {
+        dram.read(tag, addr);
     }
 
-    virtual void uartTx(const uint8_t data) {
-        putchar(data);
-        fflush(stdout);
+    virtual void dramWrite(const uint32_t addr, const bsvvector_Luint32_t_L16 data) {
+        dram.write(addr, data);
     }
 
-    virtual void uartRxReq() {
-        // printf("uartRxReq\n");
-        char c = uart_buf->deq();
-        bridgeRequestProxy->uartRxResp(c);
+    virtual void blkRead(const uint32_t sector, const uint32_t count, const uint32_t addr) {
+        blk.read(sector, count, addr);
     }
 
-    virtual void finish(unsigned int ret) {
+    virtual void finish(const uint32_t ret, const uint64_t cycles) {
+        // reported by the main thread once the console has sent all output
         ret_code = ret;
-        printf("Finish: %d\n", ret);
-        sem_post(&sem_finish);
+        finish_cycles = cycles;
+        eventfd_write(finish_fd, 1);
+    }
+
+    virtual void cycleLimitReached(const uint64_t cycles) {
+        cycle_limit_hit = true;
+        finish_cycles = cycles;
+        eventfd_write(finish_fd, 1);
     }
     BridgeIndication(unsigned int id) : BridgeIndicationWrapper(id) {}
 };
 
+static void print_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [options]\n", program_name);
+    fprintf(stderr, "  -c, --console SPEC      UART console: stdio (default), pty or unix:PATH\n");
+    fprintf(stderr, "  -l, --log-socket PATH   unix socket for read-only UART log tailers\n");
+    fprintf(stderr, "  -e, --elf FILE          guest ELF, loaded instead of the built-in mem.vmh and\n");
+    fprintf(stderr, "                          used to symbolize the profile\n");
+    fprintf(stderr, "  -p, --profile CYCLES    sample the guest pc every CYCLES cycles\n");
+    fprintf(stderr, "  -o, --profile-out PFX   write the flat profile to PFX.flat (default: profile)\n");
+    fprintf(stderr, "  -s, --stats SECONDS     print the performance counters every SECONDS and at exit\n");
+    fprintf(stderr, "  -k, --checkpoint FILE   where SIGUSR1 saves a checkpoint (default: checkpoint.bin)\n");
+    fprintf(stderr, "  -r, --restore FILE      start from a checkpoint instead of the ELF or mem.vmh\n");
+    fprintf(stderr, "  -R, --uart-record FILE  record UART input with the cycle the guest saw it at\n");
+    fprintf(stderr, "  -P, --uart-replay FILE  replay recorded UART input at the recorded cycles\n");
+    fprintf(stderr, "  -i, --input FILE        read the stdio console's input from FILE\n");
+    fprintf(stderr, "  -u, --uart-burst N      send UART output in bursts of at most N bytes, 1 to %d\n",
+            UART_BURST_LEN);
+    fprintf(stderr, "                          (default: %d)\n", UART_BURST_LEN);
+    fprintf(stderr, "  -H, --headless          keep running after console EOF, exit with the guest's\n");
+    fprintf(stderr, "                          exit code\n");
+    fprintf(stderr, "  -m, --max-cycles N      stop the core after N cycles\n");
+    fprintf(stderr, "  -t, --timeout SECONDS   stop after SECONDS of wall-clock time\n");
+    fprintf(stderr, "  -T, --tick-us US        host timer tick period (default: %d)\n", TIMER_TICK_US);
+    fprintf(stderr, "  -S, --stats-out FILE    write the counter snapshots to FILE, and take one at exit\n");
+    fprintf(stderr, "  -D, --dram MB           serve MB of guest RAM from 0x%08x out of host memory,\n", Dram::BASE);
+    fprintf(stderr, "                          needs --elf or --restore to load it\n");
+    fprintf(stderr, "  -b, --blk FILE          expose FILE to the guest as a read-only block device\n");
+    fprintf(stderr, "  -h, --help              show this help\n");
+}
+
 int main(int argc, const char **argv)
 {
     long actualFrequency = 0;
     long requestedFrequency = 1e9 / MainClockPeriod;
 
-    sem_init(&sem_finish, 0, 0);
+    const char *console_spec = "stdio";
+    const char *log_socket = nullptr;
+    const char *elf_path = nullptr;
+    uint32_t profile_interval = 0;
+    unsigned long uart_burst = UART_BURST_LEN;
+    const char *profile_out = "profile";
+    const char *restore_path = nullptr;
+    const char *input_path = nullptr;
+    const char *stats_out = nullptr;
+    uint64_t max_cycles = 0;
+    size_t dram_mb = 0;
+    const char *blk_path = nullptr;
+    unsigned int timeout_s = 0;
+    static const struct option long_options[] = {
+        {"console", required_argument, nullptr, 'c'},
+        {"log-socket", required_argument, nullptr, 'l'},
+        {"elf", required_argument, nullptr, 'e'},
+        {"profile", required_argument, nullptr, 'p'},
+        {"profile-out", required_argument, nullptr, 'o'},
+        {"stats", required_argument, nullptr, 's'},
+        {"checkpoint", required_argument, nullptr, 'k'},
+        {"restore", required_argument, nullptr, 'r'},
+        {"uart-record", required_argument, nullptr, 'R'},
+        {"uart-replay", required_argument, nullptr, 'P'},
+        {"input", required_argument, nullptr, 'i'},
+        {"uart-burst", required_argument, nullptr, 'u'},
+        {"headless", no_argument, nullptr, 'H'},
+        {"max-cycles", required_argument, nullptr, 'm'},
+        {"timeout", required_argument, nullptr, 't'},
+        {"tick-us", required_argument, nullptr, 'T'},
+        {"stats-out", required_argument, nullptr, 'S'},
+        {"dram", required_argument, nullptr, 'D'},
+        {"blk", required_argument, nullptr, 'b'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, (char * const *)argv, "c:l:e:p:o:s:k:r:R:P:i:u:Hm:t:T:S:D:b:h", long_options, nullptr)) != -1) {
+        switch (opt) {
+        case 'c':
+            console_spec = optarg;
+            break;
+        case 'l':
+            log_socket = optarg;
+            break;
+        case 'e':
+            elf_path = optarg;
+            break;
+        case 'p':
+            profile_interval = strtoul(optarg, nullptr, 0);
+            break;
+        case 'o':
+            profile_out = optarg;
+            break;
+        case 's':
+            stats_interval_s = strtoul(optarg, nullptr, 0);
+            break;
+        case 'k':
+            checkpoint_path = optarg;
+            break;
+        case 'r':
+            restore_path = optarg;
+            break;
+        case 'R':
+            if (!rx_log.openRecord(optarg)) {
+                return 1;
+            }
+            break;
+        case 'P':
+            if (!rx_log.openReplay(optarg)) {
+                return 1;
+            }
+            break;
+        case 'i':
+            input_path = optarg;
+            break;
+        case 'u':
+            uart_burst = strtoul(optarg, nullptr, 0);
+            if (uart_burst < 1 || uart_burst > UART_BURST_LEN) {
+                fprintf(stderr, "ERROR: --uart-burst must be between 1 and %d\n", UART_BURST_LEN);
+                return 1;
+            }
+            break;
+        case 'H':
+            headless = true;
+            break;
+        case 'm':
+            max_cycles = strtoull(optarg, nullptr, 0);
+            break;
+        case 't':
+            timeout_s = strtoul(optarg, nullptr, 0);
+            break;
+        case 'T':
+            timer_tick_us = strtoul(optarg, nullptr, 0);
+            if (timer_tick_us == 0) {
+                fprintf(stderr, "ERROR: the timer tick must be at least 1 us\n");
+                return 1;
+            }
+            break;
+        case 'S':
+            stats_out = optarg;
+            break;
+        case 'D':
+            dram_mb = strtoul(optarg, nullptr, 0);
+            break;
+        case 'b':
+            blk_path = optarg;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // clients of the console may go away at any time
+    signal(SIGPIPE, SIG_IGN);
+    // SIGUSR1 is handled by the event loop, block it before any thread starts
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    if (!console.open(console_spec)
+        || (log_socket && !console.openLogSocket(log_socket))
+        || (input_path && !console.openInput(input_path))
+        || (stats_out && !stats.open(stats_out))
+        || (blk_path && !blk.open(blk_path))) {
+        return 1;
+    }
+
+    ElfFile elf;
+    if (elf_path && !elf.open(elf_path)) {
+        return 1;
+    }
+    if (dram_mb != 0) {
+        if (!elf_path && !restore_path) {
+            fprintf(stderr, "ERROR: --dram needs --elf or --restore, mem.vmh only fills the BRAM\n");
+            return 1;
+        }
+        if (!dram.open(dram_mb << 20)) {
+            return 1;
+        }
+    }
+
+    rx_credit_fd = eventfd(0, 0);
+    finish_fd = eventfd(0, 0);
 
     BridgeIndication bridgeIndication(IfcNames_BridgeIndicationH2S);
     bridgeRequestProxy = new BridgeRequestProxy(IfcNames_BridgeRequestS2H);
-    uart_buf = new Buffer();
+    checkpoint.setProxy(bridgeRequestProxy, &proxy_mutex);
+    dram.setProxy(bridgeRequestProxy, &proxy_mutex);
+    blk.setProxy(bridgeRequestProxy, &proxy_mutex);
+    rx_log.setProxy(bridgeRequestProxy, &proxy_mutex);
 
     int status = setClockFrequency(0, requestedFrequency, &actualFrequency);
     fprintf(stderr, "Requested main clock frequency %5.2f, actual clock frequency %5.2f MHz status=%d errno=%d\n",
@@ -132,22 +513,86 @@ int main(int argc, const char **argv)
 	    (double)actualFrequency * 1.0e-6,
 	    status, (status != 0) ? errno : 0);
 
-    // pthread_t input_handler;
-    // pthread_t timer_handler;
+    pthread_t timer_handler;
+    pthread_t flush_handler;
+    pthread_create(&flush_handler, nullptr, *handle_flush, nullptr);
+
+    bridgeRequestProxy->profileConfig(profile_interval);
+
+    // recorded runs must not depend on host timing, so mtime follows the
+    // cycle count instead of the host tick
+    bool deterministic = rx_log.mode() != RxLog::LIVE;
+    uint32_t timer_divisor = deterministic ? requestedFrequency / 1000000 : 0;
+    bridgeRequestProxy->timerConfig(timer_divisor);
+    checkpoint.setTimerDivisor(timer_divisor);
+    bridgeRequestProxy->uartConfig(rx_log.mode());
+    bridgeRequestProxy->uartTxConfig(uart_burst);
+    bridgeRequestProxy->dramConfig(dram.size());
+    bridgeRequestProxy->blkConfig(blk.sectors());
+    if (rx_log.mode() == RxLog::REPLAY) {
+        rx_log.refill();
+    }
+
+    // the core is held until its memory is loaded
+    if (restore_path) {
+        if (!checkpoint.restore(restore_path)) {
+            return 1;
+        }
+    } else if (elf_path && !load_elf(elf)) {
+        return 1;
+    }
+    bridgeRequestProxy->setCycleLimit(max_cycles);
+    bridgeRequestProxy->startCore();
+    if (timeout_s != 0) {
+        deadline_us = monotonic_us() + (uint64_t)timeout_s * 1000000;
+    }
 
-    // input handler thread
-    // pthread_create(&input_handler, nullptr, *handle_input, nullptr);
+    // timer tick thread, mtime is driven by the host rather than by cycles
+    if (!deterministic) {
+        pthread_create(&timer_handler, nullptr, *handle_timer, nullptr);
+    }
 
-    // timer interrupt thread
-    // pthread_create(&timer_handler, nullptr, *handle_timer, nullptr);
+    pthread_t stats_handler;
+    if (stats_interval_s != 0) {
+        pthread_create(&stats_handler, nullptr, *handle_stats, nullptr);
+    }
 
-    // main thread chills
+    // main thread runs the event loop until the guest exits, a budget is used
+    // up or stdin closes
     printf("[Info] Main thread waiting\n");
-    handle_input(nullptr);
-    // sem_wait(&sem_finish);
+    event_loop();
+    if (cycle_limit_hit) {
+        printf("Cycle limit reached after %" PRIu64 " cycles\n", finish_cycles);
+        ret_code = BUDGET_EXIT_CODE;
+    } else if (time_limit_hit) {
+        printf("Time limit of %u s reached\n", timeout_s);
+        ret_code = BUDGET_EXIT_CODE;
+    } else if (ret_code != (int)0xdeadbeef) {
+        printf("Finish: %d after %" PRIu64 " cycles\n", ret_code, finish_cycles);
+    }
+    if (stats_interval_s != 0) {
+        pthread_cancel(stats_handler);
+        pthread_join(stats_handler, nullptr);
+    }
+    if (stats_interval_s != 0 || stats_out) {
+        uint64_t seen = stats.snapshots();
+        pthread_mutex_lock(&proxy_mutex);
+        bridgeRequestProxy->readCounters();
+        pthread_mutex_unlock(&proxy_mutex);
+        if (!stats.waitForSnapshot(seen, 1000)) {
+            fprintf(stderr, "[Warning] no final counter snapshot\n");
+        }
+    }
+    if (profile_interval != 0) {
+        profiler.report(profile_out, profile_interval, elf_path ? &elf : nullptr);
+    }
+    rx_log.close();
+    blk.close();
+    stats.close();
     printf("[Info] Main thread finishing\n");
-    // while(true) {}
-    // pthread_cancel(input_handler);
-    // pthread_cancel(timer_handler);
+    fflush(stdout);
+    if (!deterministic) {
+        pthread_cancel(timer_handler);
+    }
     return ret_code;
 }
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Compare the cycles of the test programs between two git revisions.
+
+Each revision is checked out into a worktree under --out, its simulator is
+built there with --core, and its own run_tests.py runs the test images from
+--build (so both revisions run exactly the same programs). The cycles and CPI
+of every test are printed side by side with the relative change, e.g. to
+measure what the last commit changed for the pipelined core:
+
+    proc/compare_revs.py --core pipelined HEAD^ HEAD matmul32
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.abspath(os.path.join(HERE, "..", ".."))
+
+
+def git(*args):
+    return subprocess.check_output(["git", "-C", REPO] + list(args)).decode().strip()
+
+
+def run_rev(rev, args):
+    rev_dir = os.path.join(args.out, rev)
+    src = os.path.join(rev_dir, "src")
+    if not os.path.exists(src):
+        git("worktree", "add", "--detach", src, rev)
+    softcore = os.path.join(src, "softcore")
+    proc = os.path.join(softcore, "proc")
+    if not args.no_build:
+        subprocess.check_call(["make", "-C", softcore, "build.verilator",
+                               "MEM=" + args.mem, "MEMLINES=" + args.memlines,
+                               "CORE=" + args.core])
+    report = os.path.join(rev_dir, "test_report.json")
+    cmd = [sys.executable, os.path.join(proc, "run_tests.py"), "-j", str(args.jobs),
+           "--exe", os.path.join(proc, "verilator", "bin", "ubuntu.exe"),
+           "--build", args.build, "--out", os.path.join(rev_dir, "runs"), "--report", report,
+           "--timeout", str(args.timeout)] + args.tests
+    # failing tests are reported in the table
+    subprocess.call(cmd)
+    with open(report) as f:
+        return {r["test"]: r for r in json.load(f)["tests"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("before", help="reference revision, e.g. a commit's parent")
+    parser.add_argument("after", help="revision to compare with it")
+    parser.add_argument("tests", nargs="*",
+                        help="tests to run, e.g. matmul32 (default: every .hex in --build)")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count(),
+                        help="simulations to run at once (default: %(default)s)")
+    parser.add_argument("--build", default=os.path.join(HERE, "test", "build"),
+                        help="directory with the test images (default: %(default)s)")
+    parser.add_argument("--core", default="multicycle",
+                        help="core both simulators are built with (default: %(default)s)")
+    parser.add_argument("--mem", default=os.path.join(REPO, "guest", "mem.vmh"),
+                        help="image the simulators are built with (default: %(default)s)")
+    parser.add_argument("--out", default=os.path.join(HERE, "bench_runs", "revs"),
+                        help="worktrees and per-test working directories (default: %(default)s)")
+    parser.add_argument("--timeout", type=int, default=300,
+                        help="wall-clock seconds before a test is stopped (default: %(default)s)")
+    parser.add_argument("--no-build", action="store_true",
+                        help="reuse the simulators built by a previous run in --out")
+    args = parser.parse_args()
+    args.build = os.path.abspath(args.build)
+    args.out = os.path.abspath(args.out)
+    args.mem = os.path.abspath(args.mem)
+    args.memlines = os.path.join(os.path.dirname(args.mem), "memlines.vmh")
+
+    revs = [git("rev-parse", "--short", r + "^{commit}") for r in (args.before, args.after)]
+    before, after = [run_rev(rev, args) for rev in revs]
+
+    print()
+    print("%-16s %14s %8s %14s %8s %9s" % ("test", revs[0] + " cycles", "CPI",
+                                           revs[1] + " cycles", "CPI", "change"))
+    for test in sorted(before):
+        a, b = before[test], after.get(test)
+        line = "%-16s" % test
+        for r in (a, b):
+            if r is None or r["status"] != "pass":
+                line += " %14s %8s" % ((r["status"] if r else "missing").upper(), "-")
+            else:
+                cpi = "%.3f" % r["cpi"] if r.get("cpi") is not None else "-"
+                line += " %14d %8s" % (r["cycles"], cpi)
+        if b is not None and a["status"] == b["status"] == "pass":
+            line += " %8.1f%%" % (100.0 * (b["cycles"] - a["cycles"]) / a["cycles"])
+        print(line)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
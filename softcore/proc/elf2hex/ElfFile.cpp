@@ -21,6 +21,8 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
@@ -32,9 +34,10 @@ ElfFile::ElfFile() {
     elf_size = 0;
     elf_data = nullptr;
     elf_bit_width = 0;
+    entry = 0;
 }
 
-bool ElfFile::open(char* filename) {
+bool ElfFile::open(const char* filename) {
     // load filename into elf_data and set elf_size
     std::ifstream elf_file;
     elf_file.open(filename, std::ios::in | std::ios::binary);
@@ -86,10 +89,16 @@ bool ElfFile::open(char* filename) {
         // 32-bit ELF
         elf_bit_width = 32;
         success = finishLoad<Elf32_Ehdr, Elf32_Phdr>();
+        if (success) {
+            loadSymbols<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym>();
+        }
     } else if (e_ident[EI_CLASS] == ELFCLASS64) {
         // 64-bit ELF
         elf_bit_width = 64;
         success = finishLoad<Elf64_Ehdr, Elf64_Phdr>();
+        if (success) {
+            loadSymbols<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>();
+        }
     } else {
         std::cerr << "ERROR: ElfFile::open(): file is neither 32-bit nor 64-bit" << std::endl;
         elf_size = 0;
@@ -113,11 +122,20 @@ const std::vector<ElfFile::Section>& ElfFile::getSections() {
     return sections;
 }
 
+unsigned long long ElfFile::getEntry() {
+    return entry;
+}
+
+const std::vector<ElfFile::Symbol>& ElfFile::getSymbols() {
+    return symbols;
+}
+
 template <typename Elf_Ehdr, typename Elf_Phdr>
 bool ElfFile::finishLoad() {
     // This uses templated types to support 32-bit and 64-bit elfs
     Elf_Ehdr *ehdr = (Elf_Ehdr*) elf_data;
     Elf_Phdr *phdr = (Elf_Phdr*) (elf_data + ehdr->e_phoff);
+    entry = ehdr->e_entry;
     if (elf_size < ehdr->e_phoff + ehdr->e_phnum * sizeof(Elf_Phdr)) {
         std::cerr << "ERROR: ElfFile::finishLoad(): file too small for expected number of program header tables" << std::endl;
         return false;
@@ -147,3 +165,42 @@ bool ElfFile::finishLoad() {
     return true;
 }
 
+
+template <typename Elf_Ehdr, typename Elf_Shdr, typename Elf_Sym>
+void ElfFile::loadSymbols() {
+    // symbols are optional, so a malformed or missing table is not an error
+    Elf_Ehdr *ehdr = (Elf_Ehdr*) elf_data;
+    if (ehdr->e_shoff == 0 || elf_size < ehdr->e_shoff + ehdr->e_shnum * sizeof(Elf_Shdr)) {
+        return;
+    }
+    Elf_Shdr *shdr = (Elf_Shdr*) (elf_data + ehdr->e_shoff);
+    for (int i = 0 ; i < ehdr->e_shnum ; i++) {
+        if (shdr[i].sh_type != SHT_SYMTAB || shdr[i].sh_link >= ehdr->e_shnum) {
+            continue;
+        }
+        Elf_Shdr *strtab = &shdr[shdr[i].sh_link];
+        if (shdr[i].sh_offset + shdr[i].sh_size > elf_size
+                || strtab->sh_offset + strtab->sh_size > elf_size) {
+            std::cerr << "WARNING: ElfFile::loadSymbols(): symbol table overflow" << std::endl;
+            return;
+        }
+        Elf_Sym *sym = (Elf_Sym*) (elf_data + shdr[i].sh_offset);
+        size_t count = shdr[i].sh_size / sizeof(Elf_Sym);
+        const char *names = elf_data + strtab->sh_offset;
+        for (size_t j = 0 ; j < count ; j++) {
+            // ST_TYPE is the same for 32-bit and 64-bit elfs
+            if (ELF32_ST_TYPE(sym[j].st_info) != STT_FUNC || sym[j].st_shndx == SHN_UNDEF
+                    || sym[j].st_name >= strtab->sh_size) {
+                continue;
+            }
+            Symbol curr_symbol;
+            curr_symbol.addr = sym[j].st_value;
+            curr_symbol.size = sym[j].st_size;
+            curr_symbol.name = std::string(names + sym[j].st_name,
+                    strnlen(names + sym[j].st_name, strtab->sh_size - sym[j].st_name));
+            symbols.push_back(curr_symbol);
+        }
+    }
+    std::sort(symbols.begin(), symbols.end(),
+            [](const Symbol &a, const Symbol &b) { return a.addr < b.addr; });
+}
@@ -21,6 +21,10 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#ifndef ELF_FILE_HPP
+#define ELF_FILE_HPP
+
+#include <string>
 #include <vector>
 
 #include <elf.h>
@@ -34,18 +38,33 @@ public:
         char* data;
     };
 
+    struct Symbol {
+        unsigned long long addr;
+        unsigned long long size;
+        std::string name;
+    };
+
     ElfFile();
-    bool open(char* filename);
+    bool open(const char* filename);
     const std::vector<Section>& getSections();
+    unsigned long long getEntry();
+    // function symbols sorted by address, empty for stripped files
+    const std::vector<Symbol>& getSymbols();
 
 private:
     template <typename Elf_Ehdr, typename Elf_Phdr>
     bool finishLoad();
+    template <typename Elf_Ehdr, typename Elf_Shdr, typename Elf_Sym>
+    void loadSymbols();
 
     char* elf_data;
     size_t elf_size;
     int elf_bit_width; // 32 or 64
+    unsigned long long entry;
 
     std::vector<Section> sections;
+    std::vector<Symbol> symbols;
 };
 
+#endif
+
@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""Run the test programs in parallel, one simulation per test.
+
+Every test runs in its own working directory under --out with its own
+memory image, and its own simulator socket, so any number of them can run at the
+same time. The bridge runs headless, so it stops as soon as the guest exits
+or its cycle or time budget is used up. A test passes when the guest exits
+with 0; the exit code and the cycle count come from the bridge's "Finish:"
+line, the retired instructions from its final counter snapshot. The results
+are written as JSON to --report.
+"""
+
+import argparse
+import json
+import os
+import re
+import signal
+import subprocess
+import sys
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ARRANGE_MEM = os.path.join(HERE, "..", "..", "tools", "arrange_mem", "arrange_mem.py")
+FINISH_RE = re.compile(r"^Finish: (-?\d+) after (\d+) cycles$", re.MULTILINE)
+INSTRET_RE = re.compile(r"^\[Stats\] instret\s+(\d+)", re.MULTILINE)
+# the bridge's exit code once --max-cycles or --timeout stopped it
+BUDGET_EXIT_CODE = 124
+
+
+def find_tests(build_dir):
+    return sorted(f[:-len(".hex")] for f in os.listdir(build_dir) if f.endswith(".hex"))
+
+
+def prepare(test, build_dir, work_dir):
+    os.makedirs(work_dir, exist_ok=True)
+    # like test.sh, the last line of elf2hex's output is not part of the image
+    with open(os.path.join(build_dir, test + ".hex")) as f:
+        lines = f.readlines()
+    with open(os.path.join(work_dir, "mem.vmh"), "w") as f:
+        f.writelines(lines[:-1])
+    # memory is initialised from the line-organised memlines.vmh
+    subprocess.check_call([sys.executable, ARRANGE_MEM], cwd=work_dir)
+
+
+def run_test(test, args):
+    work_dir = os.path.join(args.out, test)
+    prepare(test, args.build, work_dir)
+    env = dict(os.environ, BLUESIM_SOCKET_NAME=os.path.join(work_dir, "socket"))
+    log_path = os.path.join(work_dir, "output.log")
+    stats_path = os.path.join(work_dir, "stats.txt")
+    result = {"test": test, "status": "error", "exit_code": None, "cycles": None,
+              "instret": None, "cpi": None}
+    start = time.monotonic()
+    cmd = [args.exe, "--headless", "--timeout", str(args.timeout), "--stats-out", stats_path]
+    if args.max_cycles:
+        cmd += ["--max-cycles", str(args.max_cycles)]
+    with open(log_path, "w") as log:
+        proc = subprocess.Popen(cmd + args.run_args, cwd=work_dir, env=env,
+                                stdin=subprocess.DEVNULL, stdout=log,
+                                stderr=subprocess.STDOUT, start_new_session=True)
+        try:
+            # the bridge enforces the timeout itself, this is a backstop
+            proc.wait(timeout=args.timeout + 30)
+        except subprocess.TimeoutExpired:
+            # the simulator runs in a child of the bridge
+            os.killpg(proc.pid, signal.SIGKILL)
+            proc.wait()
+    if proc.returncode == BUDGET_EXIT_CODE or proc.returncode < 0:
+        result["status"] = "timeout"
+    result["seconds"] = round(time.monotonic() - start, 3)
+    with open(log_path, errors="replace") as log:
+        match = FINISH_RE.search(log.read())
+    if match:
+        result["exit_code"] = int(match.group(1))
+        result["cycles"] = int(match.group(2))
+        result["status"] = "pass" if result["exit_code"] == 0 else "fail"
+    if os.path.exists(stats_path):
+        with open(stats_path) as stats:
+            # the last snapshot is taken at exit
+            instret = INSTRET_RE.findall(stats.read())
+        if instret and result["cycles"] is not None:
+            result["instret"] = int(instret[-1])
+            if result["instret"]:
+                result["cpi"] = round(result["cycles"] / result["instret"], 3)
+    return result
+
+
+def run_suite(tests, args):
+    """Run tests with args.jobs simulations at once, printing a line per test."""
+    results = []
+    with ThreadPoolExecutor(max_workers=max(1, args.jobs)) as pool:
+        for result in pool.map(lambda t: run_test(t, args), tests):
+            cycles = result["cycles"] if result["cycles"] is not None else "-"
+            cpi = "%.3f" % result["cpi"] if result["cpi"] is not None else "-"
+            print("%-16s %-8s %12s cycles %8s CPI %8.1f s"
+                  % (result["test"], result["status"].upper(), cycles, cpi, result["seconds"]))
+            results.append(result)
+            sys.stdout.flush()
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("tests", nargs="*",
+                        help="tests to run, e.g. add32 (default: every .hex in --build)")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count(),
+                        help="simulations to run at once (default: %(default)s)")
+    parser.add_argument("--exe", default=os.path.join(HERE, "verilator", "bin", "ubuntu.exe"),
+                        help="simulation executable (default: %(default)s)")
+    parser.add_argument("--build", default=os.path.join(HERE, "test", "build"),
+                        help="directory with the test images (default: %(default)s)")
+    parser.add_argument("--out", default=os.path.join(HERE, "test_runs"),
+                        help="per-test working directories (default: %(default)s)")
+    parser.add_argument("--report", default="test_report.json",
+                        help="JSON report (default: %(default)s)")
+    parser.add_argument("--timeout", type=int, default=300,
+                        help="wall-clock seconds before a test is stopped (default: %(default)s)")
+    parser.add_argument("--max-cycles", type=int, default=0,
+                        help="cycles before a test is stopped (default: no limit)")
+    parser.add_argument("--run-args", default="",
+                        help="extra arguments for the bridge, e.g. \"--stats 10\"")
+    args = parser.parse_args()
+    args.exe = os.path.abspath(args.exe)
+    args.out = os.path.abspath(args.out)
+    args.run_args = args.run_args.split()
+
+    if not os.path.exists(args.exe):
+        sys.exit("ERROR: %s not found, build with `make build.verilator` first" % args.exe)
+    tests = args.tests or find_tests(args.build)
+    missing = [t for t in tests if not os.path.exists(os.path.join(args.build, t + ".hex"))]
+    if missing:
+        sys.exit("ERROR: no image for %s in %s, run `make -C test` first"
+                 % (", ".join(missing), args.build))
+
+    start = time.monotonic()
+    results = run_suite(tests, args)
+    elapsed = time.monotonic() - start
+
+    passed = sum(1 for r in results if r["status"] == "pass")
+    with open(args.report, "w") as f:
+        json.dump({"passed": passed, "total": len(results), "seconds": round(elapsed, 3),
+                   "tests": results}, f, indent=2)
+        f.write("\n")
+    print("%d/%d passed in %.1f s, report in %s" % (passed, len(results), elapsed, args.report))
+    return 0 if passed == len(results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
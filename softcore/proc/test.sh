@@ -6,3 +6,4 @@ if [[ $OSTYPE == 'darwin'* ]]; then
 else
 	head -n -1 test/build/$1.hex > mem.vmh
 fi
+python3 ../../tools/arrange_mem/arrange_mem.py